@@ -0,0 +1,348 @@
+/*
+ *  HackOfLife - bitboard.c
+ *  Copyright (c) 2009  Barry "Ishara" Peddycord - http://isharacomix.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  A much faster engine for the boring (but common) case where every cell
+ *  on the board is colorless and every rulestring value is either 0 or 100.
+ *  The board is packed into rows of machine words, one bit per cell, and
+ *  the neighbors of a whole word of cells are counted at once with a tree
+ *  of full adders. The life grid is only touched where a cell changed.
+ *
+ *  The packed board is kept between generations, and only the tiles that
+ *  might change are counted. Tiles that were edited since the last
+ *  generation are packed again from the life grid.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <limits.h>
+
+#include "game.h"
+#include "bitboard.h"
+#include "threads.h"
+#include "tiles.h"
+
+
+static unsigned long *cur = NULL;   /*< The packed current generation. */
+static unsigned long *nxt = NULL;   /*< The packed next generation. */
+static unsigned long *zero = NULL;  /*< A dead row for unwrapped edges. */
+static int bw, bh;                  /*< Words per row and number of rows. */
+static int fresh;                   /*< Does everything need packing? */
+
+
+/* Make sure the packed boards are big enough for a w by h grid. Returns 0
+   if we ran out of memory. */
+static int bb_reserve( int w, int h )
+{
+    int nw = ( w + BB_BITS - 1 ) / BB_BITS;     /*< Words per row. */
+
+    if ( cur != NULL && nw == bw && h == bh )
+        return 1;
+
+    bb_free();
+    cur = malloc( sizeof(unsigned long)*nw*h );
+    nxt = malloc( sizeof(unsigned long)*nw*h );
+    zero = calloc( sizeof(unsigned long), nw );
+    if ( cur == NULL || nxt == NULL || zero == NULL )
+    {
+        bb_free();
+        return 0;
+    }
+
+    bw = nw;
+    bh = h;
+    fresh = 1;
+    return 1;
+}
+
+
+/* Find the west (x-1) and east (x+1) neighbors of every bit in word k of a
+   packed row that is nw words long. The cells past the ends of the row come
+   from the other side when the grid wraps. */
+static void bb_shift( const unsigned long *r, int k, int nw, int w, int wrap,
+                      unsigned long *west, unsigned long *east )
+{
+    int last = (w-1) % BB_BITS;     /*< Bit of the last cell in the row. */
+
+    *west = r[k] << 1;
+    if ( k > 0 )
+        *west |= r[k-1] >> (BB_BITS-1);
+    else if ( wrap )
+        *west |= ( r[nw-1] >> last ) & 1;
+
+    *east = r[k] >> 1;
+    if ( k < nw-1 )
+        *east |= r[k+1] << (BB_BITS-1);
+    else if ( wrap )
+        *east |= ( r[0] & 1 ) << last;
+}
+
+
+/* Count the neighbors of the cells in word k of the packed row c, given the
+   rows above (a) and below (d). The 4-bit counts are returned as four bit
+   slices, s[0] being the ones. */
+void bb_sum( const unsigned long *a, const unsigned long *c,
+             const unsigned long *d, int k, int nw, int w, int wrap,
+             unsigned long *s )
+{
+    unsigned long nw_, no, ne, we, ea;      /*< Neighbor words. */
+    unsigned long sw, so, se;               /*< More neighbor words. */
+    unsigned long u0, u1, d0, d1, m0, m1;   /*< Partial sums. */
+    unsigned long t0, t1, t2;               /*< Carries. */
+
+    bb_shift( a, k, nw, w, wrap, &nw_, &ne );
+    bb_shift( c, k, nw, w, wrap, &we, &ea );
+    bb_shift( d, k, nw, w, wrap, &sw, &se );
+    no = a[k];
+    so = d[k];
+
+    /* Full adders for the rows above and below, a half adder for the middle
+       row. Each gives a 2-bit sum. */
+    u0 = nw_ ^ no ^ ne;
+    u1 = ( nw_ & no ) | ( ne & ( nw_ ^ no ) );
+    d0 = sw ^ so ^ se;
+    d1 = ( sw & so ) | ( se & ( sw ^ so ) );
+    m0 = we ^ ea;
+    m1 = we & ea;
+
+    /* Add the three 2-bit sums into a 4-bit count. */
+    s[0] = u0 ^ d0 ^ m0;
+    t0 = ( u0 & d0 ) | ( m0 & ( u0 ^ d0 ) );
+    t1 = u1 ^ d1 ^ m1;
+    t2 = ( u1 & d1 ) | ( m1 & ( u1 ^ d1 ) );
+    s[1] = t1 ^ t0;
+    s[2] = t2 ^ ( t1 & t0 );
+    s[3] = t2 & ( t1 & t0 );
+}
+
+
+/* Count the bits that are set in a word. */
+int bb_count( unsigned long word )
+{
+    int report = 0;             /*< The number of set bits. */
+
+    while ( word )
+    {
+        word &= word - 1;
+        report++;
+    }
+
+    return report;
+}
+
+
+/* Select the cells whose neighbor count (given as four bit slices) is one
+   of the counts in the 9-bit rule mask. */
+unsigned long bb_rule( const unsigned long *s, int mask )
+{
+    unsigned long report = 0;   /*< Matching cells. */
+    int n;                      /*< Neighbor count. */
+
+    for ( n = 0; n < 8; n++ )
+    {
+        if ( mask & (1<<n) )
+            report |= ~s[3] & ( (n&1) ? s[0] : ~s[0] )
+                            & ( (n&2) ? s[1] : ~s[1] )
+                            & ( (n&4) ? s[2] : ~s[2] );
+    }
+
+    /* Eight neighbors is the only count that sets the fourth bit. */
+    if ( mask & (1<<8) )
+        report |= s[3];
+
+    return report;
+}
+
+
+/* The generation being run, shared with every thread. */
+static char *bgrid;                 /*< The life grid. */
+static int bgw, bpitch, bwrap;      /*< Its width, row length and
+                                        wrapping. */
+static int bsmask, bbmask;          /*< The rule masks. */
+static long deltas[THREADS_MAX];     /*< Score changes of every thread. */
+
+
+/* One thread's share of a generation, which is a band of rows of tiles.
+   Each thread packs its touched tiles, waits for its neighbors to do the
+   same, counts its active tiles, and writes them back once everybody is done
+   reading the packed board. */
+static void bb_job( int id, int n, void *arg )
+{
+    int i, j, k, b, t0, t1, ty, y0, y1;     /*< Iterators. */
+    int w = bgw;                            /*< Cells per row. */
+    long delta = 0;                         /*< Our score change. */
+    int moved;                              /*< Did the tile change? */
+    const char *row;                        /*< The unpacked row. */
+    char *cell;                             /*< Cells being written. */
+    const unsigned long *a, *c, *d;         /*< Rows above, on and below. */
+    unsigned long s[4];                     /*< Neighbor count bits. */
+    unsigned long word, old;                /*< Packing and unpacking. */
+    unsigned long lastmask;                 /*< Valid bits in the last word. */
+
+    (void) arg;
+    threads_band( id, n, tiles_rows(), &t0, &t1 );
+    lastmask = ~0UL >> ( BB_BITS*bw - w );
+
+    /* Pack the live cells of the touched tiles into bits. */
+    for ( ty = t0; ty < t1; ty++ )
+    {
+        y0 = ty*TILE_H;
+        y1 = MIN( bh, y0+TILE_H );
+        for ( k = 0; k < bw; k++ )
+        {
+            if ( !fresh && !tiles_touched( k, ty ) )
+                continue;
+
+            j = MIN( BB_BITS, w - k*BB_BITS );
+            for ( i = y0; i < y1; i++ )
+            {
+                row = bgrid + (size_t) i*bpitch + k*BB_BITS;
+                word = 0;
+                for ( b = 0; b < j; b++ )
+                    word |= (unsigned long) ( IS_ALIVE( row[b] ) != 0 ) << b;
+                cur[ (size_t) i*bw+k ] = word;
+            }
+        }
+    }
+    threads_wait();
+
+    /* Count the neighbors of 64 cells at a time. */
+    for ( ty = t0; ty < t1; ty++ )
+    {
+        y0 = ty*TILE_H;
+        y1 = MIN( bh, y0+TILE_H );
+        for ( k = 0; k < bw; k++ )
+        {
+            if ( !tiles_active( k, ty ) )
+                continue;
+
+            for ( i = y0; i < y1; i++ )
+            {
+                c = cur + (size_t) i*bw;
+                if ( bwrap )
+                {
+                    a = cur + (size_t) ( (i) ? (i-1) : (bh-1) ) * bw;
+                    d = cur + (size_t) ( (i<bh-1) ? (i+1) : 0 ) * bw;
+                }
+                else
+                {
+                    a = (i) ? c - bw : zero;
+                    d = (i<bh-1) ? c + bw : zero;
+                }
+
+                bb_sum( a, c, d, k, bw, w, bwrap, s );
+                word = ( c[k] & bb_rule( s, bsmask ) ) |
+                       ( ~c[k] & bb_rule( s, bbmask ) );
+                if ( k == bw-1 )
+                    word &= lastmask;
+                nxt[ (size_t) i*bw+k ] = word;
+            }
+        }
+    }
+    threads_wait();
+
+    /* Write back only the words that changed. Alive cells are always
+       CELL_LIVE on a colorless board, so a cell is CELL_LIVE if it is alive
+       now, 0 if it just died, and whatever it was (empty or a seed)
+       otherwise. */
+    for ( ty = t0; ty < t1; ty++ )
+    {
+        y0 = ty*TILE_H;
+        y1 = MIN( bh, y0+TILE_H );
+        for ( k = 0; k < bw; k++ )
+        {
+            if ( !tiles_active( k, ty ) )
+                continue;
+
+            moved = 0;
+            for ( i = y0; i < y1; i++ )
+            {
+                word = nxt[ (size_t) i*bw+k ];
+                old = cur[ (size_t) i*bw+k ];
+                if ( word == old )
+                    continue;
+
+                moved = 1;
+                cur[ (size_t) i*bw+k ] = word;
+                delta += bb_count( word & ~old ) - bb_count( old & ~word );
+
+                b = MIN( BB_BITS, w - k*BB_BITS );
+                cell = bgrid + (size_t) i*bpitch + k*BB_BITS;
+                while ( b-- )
+                {
+                    j = cell[b];
+                    j = ( ( old >> b ) & 1 ) ? 0 : j;
+                    j = ( ( word >> b ) & 1 ) ? CELL_LIVE : j;
+                    cell[b] = j;
+                }
+            }
+
+            if ( moved )
+                tiles_changed( k, ty );
+        }
+    }
+
+    deltas[id] = delta;
+}
+
+
+/* Advance a colorless board one generation. smask and bmask hold one bit for
+   every neighbor count that always survives or is always born. Only the
+   cells that changed are written back to the grid, and the colorless score
+   is updated to match. Seeds are left alone unless a cell is born on top of
+   them, exactly like the regular engine. Only the active tiles are worked
+   on, and the work is split between all of the threads. Returns 0 if we ran
+   out of memory, in which case the board is left as it was. */
+int bb_generation( char *grid, int w, int h, int pitch, int wrap,
+                   int smask, int bmask, long *scores )
+{
+    int i;                                  /*< Iterator. */
+
+    if ( !bb_reserve( w, h ) )
+        return 0;
+
+    bgrid = grid;
+    bgw = w;
+    bpitch = pitch;
+    bwrap = wrap;
+    bsmask = smask;
+    bbmask = bmask;
+    threads_run( bb_job, NULL );
+    fresh = 0;
+
+    for ( i = 0; i < threads_count(); i++ )
+        scores[0] += deltas[i];
+    return 1;
+}
+
+
+/* Release the packed boards. */
+void bb_free( void )
+{
+    if ( cur != NULL ) free( cur );
+    if ( nxt != NULL ) free( nxt );
+    if ( zero != NULL ) free( zero );
+
+    cur = NULL;
+    nxt = NULL;
+    zero = NULL;
+    bw = 0;
+    bh = 0;
+}
@@ -0,0 +1,41 @@
+/*
+ *  HackOfLife - bitboard.h
+ *  Copyright (c) 2009  Barry "Ishara" Peddycord - http://isharacomix.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __BITBOARD_H
+#define __BITBOARD_H
+
+
+/* The number of cells packed into each word. 64 on most machines. */
+#define BB_BITS     ( (int) ( sizeof(unsigned long) * CHAR_BIT ) )
+
+
+/* Bit-packed engine for colorless, deterministic games. */
+int bb_generation( char *grid, int w, int h, int pitch, int wrap,
+                   int smask, int bmask, long *scores );
+void bb_free( void );
+
+/* Bit-parallel helpers, shared with the bit-sliced engine. */
+void bb_sum( const unsigned long *a, const unsigned long *c,
+             const unsigned long *d, int k, int nw, int w, int wrap,
+             unsigned long *s );
+unsigned long bb_rule( const unsigned long *s, int mask );
+int bb_count( unsigned long word );
+
+
+#endif /* __BITBOARD_H */
+
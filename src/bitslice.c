@@ -0,0 +1,403 @@
+/*
+ *  HackOfLife - bitslice.c
+ *  Copyright (c) 2009  Barry "Ishara" Peddycord - http://isharacomix.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  The bit-packed engine's big brother, for boards with colored cells and
+ *  seeds on them. Every row is split into one bit plane per cell state: the
+ *  seeds of each player and the live cells of each color. Neighbor counts of
+ *  every color are added up with the same full adders as the bit-packed
+ *  engine, and the majority color (including the tie rule) is picked with
+ *  bit-parallel comparisons, so one word operation handles a whole word of
+ *  cells. Rows are sliced into planes and written back eight cells at a
+ *  time, with a multiply gathering (or spreading) a bit of every cell.
+ *
+ *  The board is streamed through a window of three packed rows, so the only
+ *  memory we need is a handful of rows per thread no matter how big the
+ *  board is. Every thread streams its own band of rows. Only the words of
+ *  the active tiles are worked on, and only the words they read are packed.
+ *  There are at most six players, so cells of color 7 never show up.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <limits.h>
+
+#include "game.h"
+#include "bitboard.h"
+#include "bitslice.h"
+#include "threads.h"
+#include "tiles.h"
+
+
+/* The planes of a packed row. Plane 0 collects empty cells and is never
+   read. The last plane holds every live cell regardless of color. */
+#define BS_SEED(p)  (p)
+#define BS_LIVE(c)  (7+(c))
+#define BS_ANY      14
+#define BS_PLANES   15
+
+
+static unsigned long *win = NULL;   /*< Packed rows of every thread: three
+                                        in the window and the original row
+                                        below the band. */
+static int sw;                      /*< Words per row. */
+static int sn;                      /*< Threads with a window. */
+
+/* Make sure every thread has a row window big enough for rows w cells wide.
+   Returns 0 if we ran out of memory. */
+static int bs_reserve( int w )
+{
+    int nw = ( w + BB_BITS - 1 ) / BB_BITS;     /*< Words per row. */
+
+    if ( win != NULL && nw == sw && sn == threads_count() )
+        return 1;
+
+    bs_free();
+    win = calloc( sizeof(unsigned long), BS_PLANES*nw*4*threads_count() );
+    if ( win == NULL )
+        return 0;
+
+    sw = nw;
+    sn = threads_count();
+    return 1;
+}
+
+
+/* The generation being run, shared with every thread. */
+static char *sgrid;                 /*< The life grid. */
+static int sgw, sgh, swrap;         /*< Its size and wrapping. */
+static int spitch;                  /*< The length of its rows. */
+static int ssmask, sbmask, shatch;  /*< The rule and hatching masks. */
+static long deltas[THREADS_MAX][7]; /*< Score changes of every thread. */
+
+
+/* Eight cells at a time, on machines with 64-bit words that keep the first
+   byte of a word lowest: the bits of eight cells gathered into one byte,
+   the first cell's in bit 0, and a byte of bits spread back out over eight
+   cells. Neither multiply carries into the bits that are kept. */
+#if ULONG_MAX > 0xffffffffUL && !defined(WORDS_BIGENDIAN)
+#define BS_WIDE         1
+#define BS_ONES         0x0101010101010101UL
+#define BS_GATHER(x)    ( ( ( (x) & BS_ONES ) * 0x0102040810204080UL ) >> 56 )
+#define BS_SPREAD(b)    ( ( ( ( ( (b) * BS_ONES ) & 0x8040201008040201UL ) \
+                            + 0x7f7f7f7f7f7f7f7fUL ) >> 7 ) & BS_ONES )
+#else
+#define BS_WIDE         0
+#endif
+
+
+/* Pack the needed words of row y of the board (w cells wide) into its bit
+   planes. The four bits of the cells are sliced out eight cells at a time,
+   and the planes are put together from the slices. The other words are
+   left alone, since nobody will read them. */
+static void bs_pack( const char *grid, int y, int w, unsigned long *dst )
+{
+    const char *row;            /*< The cells being packed. */
+    int k, b, n, c;             /*< Iterators. */
+    unsigned long s0, s1, s2, s3;   /*< The bits of the cells. */
+    unsigned long x, col;       /*< Eight cells, and the cells of a color. */
+
+    for ( k = 0; k < sw; k++ )
+    {
+        if ( !tiles_needed( k, y/TILE_H ) )
+            continue;
+
+        row = grid + (size_t) y*spitch + k*BB_BITS;
+        n = MIN( BB_BITS, w - k*BB_BITS );
+        s0 = s1 = s2 = s3 = 0;
+        b = 0;
+#if BS_WIDE
+        for ( ; b+8 <= n; b += 8 )
+        {
+            memcpy( &x, row + b, sizeof(unsigned long) );
+            s0 |= BS_GATHER( x ) << b;
+            s1 |= BS_GATHER( x >> 1 ) << b;
+            s2 |= BS_GATHER( x >> 2 ) << b;
+            s3 |= BS_GATHER( x >> 3 ) << b;
+        }
+#endif
+        for ( ; b < n; b++ )
+        {
+            x = (unsigned long) row[b];
+            s0 |= ( x & 1 ) << b;
+            s1 |= ( ( x >> 1 ) & 1 ) << b;
+            s2 |= ( ( x >> 2 ) & 1 ) << b;
+            s3 |= ( ( x >> 3 ) & 1 ) << b;
+        }
+
+        /* Color 7 is never on the board, so it is left out of every plane.
+           Plane 0 gets the empty cells. */
+        for ( c = 0; c < 7; c++ )
+        {
+            col = ( ( c & 1 ) ? s0 : ~s0 ) & ( ( c & 2 ) ? s1 : ~s1 )
+                & ( ( c & 4 ) ? s2 : ~s2 );
+            dst[ BS_SEED(c)*sw + k ] = ~s3 & col;
+            dst[ BS_LIVE(c)*sw + k ] = s3 & col;
+        }
+        dst[ BS_ANY*sw + k ] = s3 & ~( s0 & s1 & s2 );
+    }
+}
+
+
+/* One thread's share of a generation. The rows just outside of the band are
+   packed before anyone starts writing, since our neighbors rewrite them. */
+static void bs_job( int id, int n, void *arg )
+{
+    char *grid = sgrid;                 /*< The life grid. */
+    int w = sgw, h = sgh, wrap = swrap; /*< The board. */
+    int i, k, b, c, y0, y1, ty;         /*< Iterators. */
+    long delta[7];                      /*< Our score changes. */
+    unsigned long *a, *m, *d, *t;       /*< Rows above, on and below. */
+    unsigned long *below;               /*< The row below the band. */
+    unsigned long tot[4], x[4];         /*< Neighbor counts. */
+    unsigned long best[4], color[3];    /*< Majority count and color. */
+    unsigned long tie, gt, eq;          /*< Comparison results. */
+    unsigned long e0, e1, e2, e3;       /*< Equal bits. */
+    unsigned long surv, born, keep;     /*< Rule results. */
+    unsigned long take, mine;           /*< New colors. */
+    unsigned long next[BS_PLANES];      /*< The new planes. */
+    unsigned long was;                  /*< A plane as it was. */
+    unsigned long changed, v0, v1, v2, v3;  /*< Unpacking. */
+#if BS_WIDE
+    unsigned long vals, old, mask;      /*< Eight cells, unpacked. */
+#endif
+    unsigned long lastmask;             /*< Valid bits in the last word. */
+    char *cell;                         /*< Cells being written. */
+
+    (void) arg;
+    threads_band( id, n, tiles_rows(), &y0, &y1 );
+    y0 = y0*TILE_H;
+    y1 = MIN( h, y1*TILE_H );
+    memset( delta, 0, sizeof(long)*7 );
+    lastmask = ~0UL >> ( BB_BITS*sw - w );
+    a = win + BS_PLANES*sw*4*id;
+    m = a + BS_PLANES*sw;
+    d = a + BS_PLANES*sw*2;
+    below = a + BS_PLANES*sw*3;
+
+    /* Fill the window, and keep the row below the band around because it
+       will have been rewritten by the time we get there. */
+    if ( y0 < y1 )
+    {
+        bs_pack( grid, y0, w, m );
+        if ( y0 > 0 || wrap )
+            bs_pack( grid, (y0) ? (y0-1) : (h-1), w, a );
+        else
+            memset( a, 0, sizeof(unsigned long)*BS_PLANES*sw );
+        if ( y1 < h || wrap )
+            bs_pack( grid, (y1<h) ? y1 : 0, w, below );
+        else
+            memset( below, 0, sizeof(unsigned long)*BS_PLANES*sw );
+    }
+    threads_wait();
+
+    for ( i = y0; i < y1; i++ )
+    {
+        if ( i < y1-1 )
+            bs_pack( grid, i+1, w, d );
+        else
+            d = below;
+
+        ty = i/TILE_H;
+        for ( k = 0; k < sw; k++ )
+        {
+            if ( !tiles_active( k, ty ) )
+                continue;
+
+            /* Apply the rulestring to the total count. */
+            bb_sum( a + BS_ANY*sw, m + BS_ANY*sw, d + BS_ANY*sw, k, sw, w,
+                    wrap, tot );
+            surv = m[ BS_ANY*sw + k ] & bb_rule( tot, ssmask );
+            born = ~m[ BS_ANY*sw + k ] & bb_rule( tot, sbmask );
+            if ( k == sw-1 )
+                born &= lastmask;
+
+            /* Find the majority color among the colored neighbors. A color
+               that beats the best so far takes over. A color that matches
+               it marks a tie, which is exactly what the old engine did. */
+            memset( best, 0, sizeof(unsigned long)*4 );
+            memset( color, 0, sizeof(unsigned long)*3 );
+            tie = 0;
+            for ( c = 1; c < 7 && ( surv | born ); c++ )
+            {
+                bb_sum( a + BS_LIVE(c)*sw, m + BS_LIVE(c)*sw,
+                        d + BS_LIVE(c)*sw, k, sw, w, wrap, x );
+
+                e3 = ~( x[3] ^ best[3] );
+                e2 = ~( x[2] ^ best[2] );
+                e1 = ~( x[1] ^ best[1] );
+                e0 = ~( x[0] ^ best[0] );
+                gt = ( x[3] & ~best[3] ) | ( e3 & ( ( x[2] & ~best[2] ) |
+                     ( e2 & ( ( x[1] & ~best[1] ) |
+                     ( e1 & x[0] & ~best[0] ) ) ) ) );
+                eq = e3 & e2 & e1 & e0;
+
+                for ( b = 0; b < 4; b++ )
+                    best[b] = ( x[b] & gt ) | ( best[b] & ~gt );
+                for ( b = 0; b < 3; b++ )
+                    color[b] = ( ( c >> b ) & 1 ) ? ( color[b] | gt )
+                                                  : ( color[b] & ~gt );
+                tie = ( tie | eq ) & ~gt;
+            }
+
+            /* Survivors keep their color on a tie. Everyone else takes the
+               majority color, or stays colorless on a tie. */
+            keep = surv & tie;
+            take = ( surv | born ) & ~tie;
+            next[BS_LIVE(0)] = ( m[ BS_LIVE(0)*sw + k ] & keep ) |
+                               ( born & tie );
+            for ( c = 1; c < 7; c++ )
+            {
+                mine = take & ( ( c & 1 ) ? color[0] : ~color[0] )
+                            & ( ( c & 2 ) ? color[1] : ~color[1] )
+                            & ( ( c & 4 ) ? color[2] : ~color[2] );
+                next[BS_LIVE(c)] = ( m[ BS_LIVE(c)*sw + k ] & keep ) | mine;
+
+                /* Births destroy seeds, and the rest hatch if asked. */
+                next[BS_SEED(c)] = m[ BS_SEED(c)*sw + k ] & ~born;
+                if ( shatch & (1<<c) )
+                {
+                    next[BS_LIVE(c)] |= next[BS_SEED(c)];
+                    next[BS_SEED(c)] = 0;
+                }
+            }
+
+            /* Update the scores and find the cells that changed. */
+            changed = 0;
+            for ( c = 0; c < 7; c++ )
+            {
+                was = m[ BS_LIVE(c)*sw + k ];
+                if ( next[BS_LIVE(c)] == was )
+                    continue;
+                delta[c] += bb_count( next[BS_LIVE(c)] & ~was )
+                           - bb_count( was & ~next[BS_LIVE(c)] );
+                changed |= next[BS_LIVE(c)] ^ was;
+            }
+            for ( c = 1; c < 7; c++ )
+                changed |= next[BS_SEED(c)] ^ m[ BS_SEED(c)*sw + k ];
+            if ( !changed )
+                continue;
+            tiles_changed( k, ty );
+
+            /* Build the four bits of every cell out of the planes, then
+               write back only the cells that changed. */
+            v3 = next[7] | next[8] | next[9] | next[10] | next[11]
+               | next[12] | next[13];
+            v0 = next[1] | next[3] | next[5] | next[8] | next[10]
+               | next[12];
+            v1 = next[2] | next[3] | next[6] | next[9] | next[10]
+               | next[13];
+            v2 = next[4] | next[5] | next[6] | next[11] | next[12]
+               | next[13];
+
+            cell = grid + (size_t) i*spitch + k*BB_BITS;
+            for ( b = 0; changed; b += 8, changed >>= 8 )
+            {
+                /* Skip quiet bytes wholesale. */
+                if ( !( changed & 0xff ) )
+                    continue;
+
+#if BS_WIDE
+                /* Eight cells are merged into the row at once, unless they
+                   would run past its end. */
+                vals = BS_SPREAD( ( v0 >> b ) & 0xff )
+                     | BS_SPREAD( ( v1 >> b ) & 0xff ) << 1
+                     | BS_SPREAD( ( v2 >> b ) & 0xff ) << 2
+                     | BS_SPREAD( ( v3 >> b ) & 0xff ) << 3;
+                if ( k*BB_BITS + b+8 <= w )
+                {
+                    memcpy( &old, cell + b, sizeof(unsigned long) );
+                    mask = BS_SPREAD( changed & 0xff ) * 0xff;
+                    old = ( old & ~mask ) | ( vals & mask );
+                    memcpy( cell + b, &old, sizeof(unsigned long) );
+                    continue;
+                }
+                for ( c = 0; c < 8; c++ )
+                {
+                    if ( changed & ( 1UL << c ) )
+                        cell[b+c] = (char) ( ( vals >> 8*c ) & 0xff );
+                }
+#else
+                for ( c = 0; c < 8; c++ )
+                {
+                    if ( changed & ( 1UL << c ) )
+                        cell[b+c] = (char) ( ( ( v0 >> (b+c) ) & 1 )
+                                  | ( ( ( v1 >> (b+c) ) & 1 ) << 1 )
+                                  | ( ( ( v2 >> (b+c) ) & 1 ) << 2 )
+                                  | ( ( ( v3 >> (b+c) ) & 1 ) << 3 ) );
+                }
+#endif
+            }
+        }
+
+        /* Slide the window down a row. */
+        t = a;
+        a = m;
+        m = d;
+        d = t;
+    }
+
+    memcpy( deltas[id], delta, sizeof(long)*7 );
+}
+
+
+/* Advance a colored board one generation. smask and bmask hold one bit for
+   every neighbor count that always survives or is always born, and hatch
+   holds one bit for every player whose seeds hatch this generation. Only
+   the cells that changed are written back, and the scores of every color
+   are updated to match. Only the active tiles are worked on, and the work
+   is split between all of the threads. Returns 0 if we ran out of memory,
+   in which case the board is left as it was. */
+int bs_generation( char *grid, int w, int h, int pitch, int wrap,
+                   int smask, int bmask, int hatch, long *scores )
+{
+    int i, c;                           /*< Iterators. */
+
+    if ( !bs_reserve( w ) )
+        return 0;
+
+    sgrid = grid;
+    sgw = w;
+    sgh = h;
+    spitch = pitch;
+    swrap = wrap;
+    ssmask = smask;
+    sbmask = bmask;
+    shatch = hatch;
+    threads_run( bs_job, NULL );
+
+    for ( i = 0; i < threads_count(); i++ )
+    {
+        for ( c = 0; c < 7; c++ )
+            scores[c] += deltas[i][c];
+    }
+    return 1;
+}
+
+
+/* Release the row window. */
+void bs_free( void )
+{
+    if ( win != NULL ) free( win );
+
+    win = NULL;
+    sw = 0;
+    sn = 0;
+}
@@ -0,0 +1,65 @@
+#!/bin/sh
+#
+#  HackOfLife - check.sh
+#  Copyright (c) 2009  Barry "Ishara" Peddycord - http://isharacomix.com
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+#  The checks run by make check. Each one plays a board with -check, which
+#  fails if the board depends on how the game got there. The game is run
+#  with a home of its own, so it gets the default options.
+
+home=check-home.$$
+rm -rf $home
+mkdir $home || exit 1
+trap 'rm -rf $home' 0
+
+failed=0
+check()
+{
+    HOME=$home ./hackoflife "$@" > $home/out || failed=1
+    cat $home/out
+}
+
+# The dice, which have to come out even.
+check -dice=1000000
+
+# Boards that have to be found repeating themselves.
+cycles()
+{
+    check "$@"
+    grep "repeats itself" $home/out > /dev/null || failed=1
+}
+
+# Skipping to the end of a cycle, with every engine that can run the board.
+for engine in bit-packed regular blocked packed tiled sparse
+do
+    cycles -gw=64 -gh=64 -check=3000 -threads=3 -engine=$engine
+done
+
+# The engine the game picks, whose fast-forward has to go through HashLife.
+cycles -gw=300 -gh=100 -check=3000 -threads=3
+grep "fast-forward, hashlife" $home/out > /dev/null || failed=1
+
+# A colorless board of noise, which the bit-packed engine runs without
+# colors at all.
+check -gw=200 -gh=100 -check=500 -threads=3 -noise
+
+# A board kept in a file, which the mapped engine runs as well.
+check -gw=200 -gh=100 -check=500 -threads=3 -board=$home/board.hol
+
+# A board wider than the grids used to allow.
+check -gw=12000 -gh=40 -check=200 -threads=3
+
+exit $failed
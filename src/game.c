@@ -34,6 +34,9 @@
 #include "world.h"
 #include "network.h"
 #include "random.h"
+#include "threads.h"
+#include "grids.h"
+#include "sparse.h"
 
 
 static int running;                 /*< True while the game is running. */
@@ -58,19 +61,25 @@ static const char *omenu[] =
      " RULESTRING S(7)"," RULESTRING S(8)"," RULESTRING B(0)",
      " RULESTRING B(1)"," RULESTRING B(2)"," RULESTRING B(3)",
      " RULESTRING B(4)"," RULESTRING B(5)"," RULESTRING B(6)",
-     " RULESTRING B(7)"," RULESTRING B(8)"," SAVE OPTIONS"," EXIT"};
+     " RULESTRING B(7)"," RULESTRING B(8)"," THREADS"," KERNEL",
+     " SPARSE BELOW"," DENSE ABOVE"," SAVE OPTIONS"," EXIT"};
 static const char *cmenu[] =
     {"COLOR:"," RED"," YELLOW"," GREEN"," CYAN"," BLUE"," MAGENTA"};
 static const char *bmenu[] =
     {"OTHER CELLS:"," PASSIVE"," SOLID"," DEADLY"};
 static const char *rmenu[] =
     {"RULES:"," SURVIVAL"," EXTERMINATION"," PROLIFERATION"," SANDBOX"};
+static const char *kmenu[] =
+    {"KERNEL:"," NEIGHBORS"," COLUMN SUMS"};
 
 
 /* The main method. Program execution begins here. */
 int main( int argc, char **argv )
 {
     int i, c, n;        /*< Iterator and temp vals. */
+    int bench = 0;      /*< Generations to benchmark. */
+    int check = 0;      /*< Generations to check. */
+    long dice = 0;      /*< Dice to roll to check them. */
     char *m;            /*< Standard issue char pointer. */
     
     /* Load our options. If no conf file exists, then we load the default
@@ -84,6 +93,57 @@ int main( int argc, char **argv )
             sscanf( argv[i]+3, "%d", life_opts()+OP_TERMINAL_WIDTH );
         else if ( strncmp( argv[i], "-h=", 3 ) == 0 )
             sscanf( argv[i]+3, "%d", life_opts()+OP_TERMINAL_HEIGHT );
+        else if ( strncmp( argv[i], "-gw=", 4 ) == 0 )
+            sscanf( argv[i]+4, "%d", life_opts()+OP_GRID_WIDTH );
+        else if ( strncmp( argv[i], "-gh=", 4 ) == 0 )
+            sscanf( argv[i]+4, "%d", life_opts()+OP_GRID_HEIGHT );
+        else if ( strncmp( argv[i], "-threads=", 9 ) == 0 )
+        {
+            sscanf( argv[i]+9, "%d", life_opts()+OP_THREADS );
+            threads_bind( 1 );
+        }
+        else if ( strncmp( argv[i], "-bench=", 7 ) == 0 )
+            sscanf( argv[i]+7, "%d", &bench );
+        else if ( strncmp( argv[i], "-check=", 7 ) == 0 )
+            sscanf( argv[i]+7, "%d", &check );
+        else if ( strncmp( argv[i], "-dice=", 6 ) == 0 )
+            sscanf( argv[i]+6, "%ld", &dice );
+        else if ( strncmp( argv[i], "-board=", 7 ) == 0 )
+            keep_board( argv[i]+7 );
+        else if ( strcmp( argv[i], "-noise" ) == 0 )
+            life_opts()[OP_NOISE] = 1;
+        else if ( strcmp( argv[i], "-numa" ) == 0 && !grid_bind( 1 ) )
+        {
+            printf( "This system can't place memory on nodes.\n" );
+            return EXIT_FAILURE;
+        }
+        else if ( strcmp( argv[i], "-numa" ) == 0 )
+            threads_bind( 1 );
+        else if ( strncmp( argv[i], "-engine=", 8 ) == 0 &&
+                  !force_engine( argv[i]+8 ) )
+        {
+            printf( "There is no %s engine.\n", argv[i]+8 );
+            return EXIT_FAILURE;
+        }
+    }
+    
+    /* Benchmarking doesn't need the interface at all. */
+    if ( bench > 0 )
+    {
+        if ( !validate_options() )
+            return EXIT_FAILURE;
+        bench_game( bench );
+        return EXIT_SUCCESS;
+    }
+    
+    /* Neither does checking. */
+    if ( dice > 0 )
+        return ( check_dice( dice ) ) ? EXIT_SUCCESS : EXIT_FAILURE;
+    if ( check > 0 )
+    {
+        if ( !validate_options() || !check_game( check ) )
+            return EXIT_FAILURE;
+        return EXIT_SUCCESS;
     }
     
     /* Prepare the environment. */
@@ -133,7 +193,7 @@ int main( int argc, char **argv )
                             /* Collect the rules and the number of players. */
                             memset( sbuffer, 0, sizeof(char)*1024 );
                             m = sbuffer;
-                            for ( i = 5; i < OP_N; i++ )
+                            for ( i = 5; i < OP_NET_N; i++ )
                                 m += sprintf( m, "%d ", life_opts()[i] );
                             sprintf( m, "%d", n );
                             
@@ -191,7 +251,7 @@ int main( int argc, char **argv )
                             m = wait_message( 0, -1 );
                             
                             /* Get the rules from 'm' */
-                            for ( i = 5; i < OP_N && m != NULL; i++ )
+                            for ( i = 5; i < OP_NET_N && m != NULL; i++ )
                             {
                                 if ( sscanf( m, "%d", life_opts()+i ) == 1 )
                                 {
@@ -231,6 +291,8 @@ int main( int argc, char **argv )
                             life_opts()[i] = go_menu(1, 1, 20, 4, 3, bmenu, 0);
                         else if ( i == OP_RULES )
                             life_opts()[i] = go_menu(1, 1, 20, 5, 4, rmenu, 0);
+                        else if ( i == OP_KERNEL )
+                            life_opts()[i] = go_menu(1, 1, 20, 3, 2, kmenu, 0);
                         else if ( i == OP_SERIAL_GLYPHS || i == OP_SPACED_GRID
                                   || i == OP_GRID_WRAP || i == OP_NOISE )
                             life_opts()[i] = (life_opts()[i]) ? 0: 1;
@@ -277,6 +339,13 @@ void load_options( void )
         strcat( cfgfile, "/.lifecf" );
     #endif
     
+    /* The local options are set first, so files older than them keep their
+       defaults. */
+    opts[OP_THREADS]            = 0;
+    opts[OP_KERNEL]             = OPx_COLUMNS;
+    opts[OP_SPARSE_BELOW]       = 20;
+    opts[OP_DENSE_ABOVE]        = 50;
+    
     /* Try to load from a file. */
     ifile = fopen( cfgfile, "r" );
     if ( ifile )
@@ -286,7 +355,8 @@ void load_options( void )
             i++;
         fclose( ifile );
         
-        if ( i == OP_N && validate_options() )
+        /* Older files do not have the local options at the end. */
+        if ( i >= OP_NET_N && validate_options() )
             return;
     }
     
@@ -407,14 +477,14 @@ int validate_options( void )
     }
     
     val = opts[OP_GRID_WIDTH];
-    if ( val < 5 || val > 10000 )
+    if ( val < 5 || val > SP_MAX )
     {
         report = 0;
         opts[OP_GRID_WIDTH] = 20;
     }
     
     val = opts[OP_GRID_HEIGHT];
-    if ( val < 5 || val > 10000 )
+    if ( val < 5 || val > SP_MAX )
     {
         report = 0;
         opts[OP_GRID_HEIGHT] = 20;
@@ -486,6 +556,34 @@ int validate_options( void )
         }
     }
     
+    val = opts[OP_THREADS];
+    if ( val < 0 || val > THREADS_MAX )
+    {
+        report = 0;
+        opts[OP_THREADS] = 0;
+    }
+    
+    val = opts[OP_KERNEL];
+    if ( val < OPx_NEIGHBORS || val > OPx_COLUMNS )
+    {
+        report = 0;
+        opts[OP_KERNEL] = OPx_COLUMNS;
+    }
+    
+    val = opts[OP_SPARSE_BELOW];
+    if ( val < 0 || val > 9999 )
+    {
+        report = 0;
+        opts[OP_SPARSE_BELOW] = 20;
+    }
+    
+    val = opts[OP_DENSE_ABOVE];
+    if ( val <= opts[OP_SPARSE_BELOW] || val > 10000 )
+    {
+        report = 0;
+        opts[OP_DENSE_ABOVE] = MAX( 50, opts[OP_SPARSE_BELOW]+1 );
+    }
+    
     set_size( opts[OP_TERMINAL_WIDTH], opts[OP_TERMINAL_HEIGHT] );
     return report;
 }
@@ -617,6 +715,27 @@ int go_menu( int x, int y, int w, int h, int s, const char *options[], int go )
                     if ( life_opts()[ top+c ] ) printw( "ON" );
                     else                          printw( "OFF" );
                 }
+                else if ( top+c == OP_KERNEL )
+                {
+                    switch ( life_opts()[ top+c ] )
+                    {
+                        case OPx_NEIGHBORS  : printw( "Neighbors" );
+                                              break;
+                        case OPx_COLUMNS    : printw( "Column sums" );
+                                              break;
+                        default             : printw( "INVALID" );
+                                              break;
+                    }
+                }
+                else if ( top+c == OP_THREADS && life_opts()[ top+c ] == 0 )
+                {
+                    printw( "Auto" );
+                }
+                else if ( top+c == OP_SPARSE_BELOW &&
+                          life_opts()[ top+c ] == 0 )
+                {
+                    printw( "Never" );
+                }
                 else
                 {
                     printw( "%d", life_opts()[ top+c ] );
@@ -710,9 +829,9 @@ void writeint( unsigned int i, FILE *ofile )
     
     /* Use pure maths to build it. */
     c[0] = i % 0x100;
-    c[1] = (i / 0x100)%100;
-    c[2] = (i / 0x10000)%100;
-    c[3] = (i / 0x1000000)%100;
+    c[1] = (i / 0x100)%0x100;
+    c[2] = (i / 0x10000)%0x100;
+    c[3] = (i / 0x1000000)%0x100;
     
     fwrite( c, sizeof(unsigned char), 4, ofile );
 }
@@ -24,6 +24,14 @@
 #define MAX(a,b)  ( ( (a) > (b) ) ? (a) : (b) )
 #define MIN(a,b)  ( ( (a) < (b) ) ? (a) : (b) )
 
+/* Cells of the grid of life fit in four bits. The low three are the color
+   (0 for colorless cells) and the top one is set if the cell is alive, so a
+   dead cell with a color is a seed. */
+#define CELL_LIVE           8
+#define CELL_STATES         16
+#define IS_ALIVE(v)         ( (v) & CELL_LIVE )
+#define COLOR_OF(v)         ( (v) & 7 )
+
 /* Our option values in the options array. */
 #define OP_PLAYER_COLOR     0
 #define OP_SERIAL_GLYPHS    1
@@ -50,7 +58,14 @@
     #define OPx_SANDBOX         3
 #define OP_RULESTRING_S(x)  (16+(x))
 #define OP_RULESTRING_B(x)  (25+(x))
-#define OP_N                34
+#define OP_NET_N            34
+#define OP_THREADS          34
+#define OP_KERNEL           35
+    #define OPx_NEIGHBORS       0
+    #define OPx_COLUMNS         1
+#define OP_SPARSE_BELOW     36
+#define OP_DENSE_ABOVE      37
+#define OP_N                38
 
 
 /* Functions for dealing with the game's many options. */
@@ -0,0 +1,468 @@
+/*
+ *  HackOfLife - grids.c
+ *  Copyright (c) 2009  Barry "Ishara" Peddycord - http://isharacomix.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Memory for the board grids. Big grids are mapped straight from the
+ *  system, on huge pages when it has them, so a generation walks through
+ *  far fewer pages. Small grids, and systems that can't map memory, get it
+ *  from calloc like everything else. The pages are only filled in when they
+ *  are first touched, so the system would happily hand out more of them
+ *  than it has, and grids that don't fit in memory are turned down up front.
+ *  The biggest ones hand their pages back when they are emptied, instead of
+ *  writing zeroes over them.
+ *
+ *  A board can also be kept in a file instead, for boards bigger than
+ *  memory. Its grids are mapped from the file, and the system reads them in
+ *  and writes them back as they are used, so only the part being worked on
+ *  has to fit. Emptying one cuts the pages out of the file, instead of
+ *  writing zeroes over every one of them.
+ *
+ *  On machines with more than one memory node, the system puts a page on
+ *  the node of the processor that first touches it. The engines have every
+ *  thread touch its own part of the grids first, and can also ask for it
+ *  to be kept on that thread's node no matter who touches it.
+ */
+
+/* mmap's flags and madvise are left out by -ansi unless we ask for them,
+   and files past 2 GB need a big enough off_t. */
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _DARWIN_C_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <limits.h>
+
+#ifdef HAVE_UNISTD_H
+    #include <unistd.h>
+#endif
+
+#ifdef HAVE_FCNTL_H
+    #include <fcntl.h>
+#endif
+
+#ifdef HAVE_SYS_STAT_H
+    #include <sys/stat.h>
+#endif
+
+#ifdef HAVE_SYS_MMAN_H
+    #include <sys/mman.h>
+    #if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+        #define MAP_ANONYMOUS MAP_ANON
+    #endif
+    #ifndef MAP_ANONYMOUS
+        #undef HAVE_SYS_MMAN_H
+    #endif
+#endif
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_UNISTD_H) && defined(__linux__)
+    #include <sys/syscall.h>
+    #if defined(SYS_mbind) && defined(SYS_getcpu)
+        #define GRID_NODES
+        #define GRID_PREFERRED 1    /*< MPOL_PREFERRED, which isn't in any
+                                        header we can count on. */
+    #endif
+#endif
+
+#include "grids.h"
+
+
+#define GRID_HEAD   64          /*< Bytes kept in front of every grid. */
+#define GRID_MAP    262144      /*< Grids this big or bigger are mapped... */
+#define GRID_PAGE   4096        /*< ...in pages of this size... */
+#define GRID_HUGE   2097152     /*< ...or of this size, if we can. */
+#define GRID_DROP   67108864    /*< Grids this big hand their pages back
+                                        when they are emptied. */
+
+/* What is kept in front of a grid, so it can be given back. */
+struct grid_head
+{
+    size_t len;                 /*< How much was reserved in all. */
+    size_t page;                /*< The size of its pages, or 0 if it came
+                                        from calloc. */
+    int file;                   /*< Is it kept in the board file? */
+};
+
+static double held = 0;         /*< Bytes of grids handed out. */
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_UNISTD_H) && \
+    defined(HAVE_FCNTL_H) && defined(HAVE_SYS_STAT_H)
+    #define GRID_FILES
+static int map_fd = -1;         /*< The board file... */
+static char *map_base;          /*< ...where it is mapped... */
+static size_t map_len;          /*< ...how long it is... */
+static int map_refs;            /*< ...and how many of its grids are in
+                                        use. */
+#endif
+
+static int binding = 0;         /*< Are grids placed on memory nodes? */
+
+
+/* How much memory the system could hand out, in bytes, or 0 if it can't
+   tell. The page cache is given back when something needs the room, so it
+   counts, which the free memory the system reports on its own leaves out.
+   Linux adds it up for us as MemAvailable. Elsewhere, all of the memory
+   the machine has will have to do. */
+static double grid_avail( void )
+{
+    double mem = 0;             /*< The memory there is. */
+
+    #ifdef __linux__
+    FILE *f;                    /*< The system's count of its memory. */
+    char line[80];              /*< A line of it. */
+    unsigned long kb;           /*< The memory in it, in kB. */
+
+    f = fopen( "/proc/meminfo", "r" );
+    if ( f != NULL )
+    {
+        while ( mem == 0 && fgets( line, sizeof(line), f ) != NULL )
+        {
+            if ( sscanf( line, "MemAvailable: %lu", &kb ) == 1 )
+                mem = (double) kb * 1024;
+        }
+        fclose( f );
+    }
+    #endif
+
+    #if defined(HAVE_UNISTD_H) && defined(_SC_PHYS_PAGES) && \
+        defined(_SC_PAGESIZE)
+    if ( mem == 0 )
+        mem = (double) sysconf( _SC_PHYS_PAGES ) *
+              (double) sysconf( _SC_PAGESIZE );
+    #endif
+
+    return ( mem > 0 ) ? mem : 0;
+}
+
+
+/* Is there room in memory for n more bytes of grids? The system only counts
+   pages once they are touched, so the grids already handed out are taken
+   off the memory it could hand out as well, whether they have been touched
+   or not. Systems that can't tell always have room. */
+static int grid_room( size_t n )
+{
+    double mem = grid_avail();  /*< The memory there is. */
+
+    return ( mem == 0 || held + n <= mem );
+}
+
+
+/* n bytes for a grid, all zero, or NULL if we ran out of memory. */
+void *grid_alloc( size_t n )
+{
+    struct grid_head *h = NULL; /*< The front of the grid. */
+
+    #ifdef HAVE_SYS_MMAN_H
+    size_t len;                 /*< The length of the mapping. */
+    void *p;                    /*< The mapping. */
+    #endif
+
+    if ( n > (size_t) -1 - GRID_HUGE || !grid_room( n ) )
+        return NULL;
+
+    #ifdef HAVE_SYS_MMAN_H
+    if ( n + GRID_HEAD >= GRID_MAP )
+    {
+        /* Explicit huge pages have to be set aside by the administrator,
+           so they usually aren't there. Then we map plain pages and ask
+           for them to be put together into huge ones. */
+        p = MAP_FAILED;
+        len = ( n + GRID_HEAD + GRID_HUGE - 1 ) / GRID_HUGE * GRID_HUGE;
+        #ifdef MAP_HUGETLB
+        p = mmap( NULL, len, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+        #endif
+        if ( p != MAP_FAILED )
+        {
+            h = p;
+            h->page = GRID_HUGE;
+        }
+        else
+        {
+            len = ( n + GRID_HEAD + GRID_PAGE - 1 ) / GRID_PAGE * GRID_PAGE;
+            p = mmap( NULL, len, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+            if ( p == MAP_FAILED )
+                return NULL;
+            #ifdef MADV_HUGEPAGE
+            madvise( p, len, MADV_HUGEPAGE );
+            #endif
+            h = p;
+            h->page = GRID_PAGE;
+        }
+        h->len = len;
+    }
+    #endif
+
+    if ( h == NULL )
+    {
+        h = calloc( 1, n + GRID_HEAD );
+        if ( h == NULL )
+            return NULL;
+        h->len = n + GRID_HEAD;
+        h->page = 0;
+    }
+    h->file = 0;
+    held += h->len;
+    return (char *) h + GRID_HEAD;
+}
+
+
+/* Give a grid back. */
+void grid_free( void *p )
+{
+    struct grid_head *h;        /*< The front of the grid. */
+
+    if ( p == NULL )
+        return;
+
+    h = (struct grid_head *) ( (char *) p - GRID_HEAD );
+    #ifdef GRID_FILES
+    if ( h->file )
+    {
+        /* The file goes once none of its grids are in use. */
+        if ( --map_refs == 0 )
+        {
+            munmap( map_base, map_len );
+            close( map_fd );
+            map_fd = -1;
+        }
+        return;
+    }
+    #endif
+
+    held -= h->len;
+    #ifdef HAVE_SYS_MMAN_H
+    if ( h->page )
+    {
+        munmap( h, h->len );
+        return;
+    }
+    #endif
+    free( h );
+}
+
+
+/* Set bytes a up to b of grid p to zero. In the board file, the whole
+   pages among them are cut out of it instead, if the system can, so they
+   don't have to be written out to the disk. Grids in memory of GRID_DROP
+   bytes or more hand their pages back, and the system zeroes them again
+   as they are touched. That makes a new round start at once, and costs
+   the next game about as much as the zeroes would have if it fills the
+   whole board. Smaller grids are written over with zeroes, which is
+   quicker than finding the pages again. Each thread can empty the part
+   of a grid it works on. */
+void grid_clear( void *p, size_t a, size_t b )
+{
+    #ifdef HAVE_SYS_MMAN_H
+    struct grid_head *h;        /*< The front of the grid. */
+    size_t pa, pb;              /*< The whole pages, from pa up to pb. */
+    int how = -1;               /*< How to give them back. */
+
+    h = (struct grid_head *) ( (char *) p - GRID_HEAD );
+    #if defined(GRID_FILES) && defined(MADV_REMOVE)
+    if ( h->file )
+        how = MADV_REMOVE;
+    #endif
+    #ifdef MADV_DONTNEED
+    if ( !h->file && h->page && h->len - GRID_HEAD >= GRID_DROP )
+        how = MADV_DONTNEED;
+    #endif
+
+    if ( how != -1 )
+    {
+        pa = ( GRID_HEAD + a + h->page - 1 ) / h->page * h->page;
+        pb = ( GRID_HEAD + b ) / h->page * h->page;
+        if ( pa < pb && !madvise( (char *) h + pa, pb - pa, how ) )
+        {
+            memset( (char *) p + a, 0, pa - GRID_HEAD - a );
+            memset( (char *) h + pb, 0, GRID_HEAD + b - pb );
+            return;
+        }
+    }
+    #endif
+
+    memset( (char *) p + a, 0, b - a );
+}
+
+
+/* Keep k grids of n bytes in the file called name, after a front of hn
+   bytes that the caller can use as it likes. If fresh, the file is started
+   over with nothing in it; otherwise it has to hold k grids of that size
+   already. The grids go in grids[0] up to grids[k-1], to be given back with
+   grid_free(). Returns the front of the file, or NULL if it can't be used. */
+void *grid_map( const char *name, size_t hn, size_t n, int k, int fresh,
+                char **grids )
+{
+    #ifdef GRID_FILES
+    struct grid_head *h;        /*< The front of a grid. */
+    struct stat st;             /*< What the file is like now. */
+    size_t a, len;              /*< The room taken by a grid, and by the
+                                        whole file. */
+    void *p;                    /*< The mapping. */
+    int i;                      /*< Iterator. */
+
+    if ( map_fd >= 0 || hn > GRID_PAGE || k < 1 ||
+         n > (size_t) -1 / k - GRID_PAGE*2 )
+        return NULL;
+    a = ( GRID_HEAD + n + GRID_PAGE - 1 ) / GRID_PAGE * GRID_PAGE;
+    len = GRID_PAGE + a*k;
+
+    /* Every grid starts on a page of its own, after the front. */
+    map_fd = open( name, O_RDWR | O_CREAT, 0644 );
+    if ( map_fd < 0 )
+        return NULL;
+    if ( fstat( map_fd, &st ) != 0 ||
+         ( !fresh && (double) st.st_size != (double) len ) ||
+         ( fresh && ( ftruncate( map_fd, 0 ) != 0 ||
+                      ftruncate( map_fd, (off_t) len ) != 0 ) ) )
+    {
+        close( map_fd );
+        map_fd = -1;
+        return NULL;
+    }
+
+    p = mmap( NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED,
+              map_fd, 0 );
+    if ( p == MAP_FAILED )
+    {
+        close( map_fd );
+        map_fd = -1;
+        return NULL;
+    }
+
+    /* The engines sweep the grids from top to bottom, so the system can
+       read ahead and let go of what is behind. */
+    #ifdef MADV_SEQUENTIAL
+    madvise( p, len, MADV_SEQUENTIAL );
+    #endif
+
+    map_base = p;
+    map_len = len;
+    map_refs = k;
+    for ( i = 0; i < k; i++ )
+    {
+        h = (struct grid_head *) ( map_base + GRID_PAGE + a*i );
+        h->len = a;
+        h->page = GRID_PAGE;
+        h->file = 1;
+        grids[i] = (char *) h + GRID_HEAD;
+    }
+    return map_base;
+    #else
+    (void) name;
+    (void) hn;
+    (void) n;
+    (void) k;
+    (void) fresh;
+    (void) grids;
+    return NULL;
+    #endif
+}
+
+
+/* Ask for the n bytes of a grid at p to be read in from the board file,
+   since they are about to be needed. */
+void grid_ahead( const void *p, size_t n )
+{
+    #ifdef GRID_FILES
+    size_t a, b;                /*< The pages, from a up to b. */
+
+    if ( map_fd < 0 || (const char *) p < map_base ||
+         (const char *) p >= map_base + map_len )
+        return;
+
+    b = (size_t) ( (const char *) p - map_base );
+    a = b / GRID_PAGE * GRID_PAGE;
+    b = ( n < map_len - b ) ? b + n : map_len;
+    #ifdef MADV_WILLNEED
+    madvise( map_base + a, b - a, MADV_WILLNEED );
+    #endif
+    #else
+    (void) p;
+    (void) n;
+    #endif
+}
+
+
+/* Write whatever changed in the grids of the board file, or in the front of
+   it if front is set, out to the disk, and wait until it is there. */
+void grid_sync( int front )
+{
+    #ifdef GRID_FILES
+    if ( map_fd >= 0 && front )
+        msync( map_base, GRID_PAGE, MS_SYNC );
+    else if ( map_fd >= 0 )
+        msync( map_base + GRID_PAGE, map_len - GRID_PAGE, MS_SYNC );
+    #else
+    (void) front;
+    #endif
+}
+
+
+/* Have grid_place() keep grids on memory nodes, or not. Returns 0 if the
+   system can't. */
+int grid_bind( int on )
+{
+    #ifdef GRID_NODES
+    binding = on;
+    return 1;
+    #else
+    binding = 0;
+    return !on;
+    #endif
+}
+
+
+/* Ask for bytes a up to b of grid p to be kept on the memory node of the
+   processor we are running on, so that is where they go no matter which
+   thread touches them first. Only the whole pages among them can be, and
+   only in grids mapped on plain pages. Does nothing unless grid_bind() was
+   asked to. */
+void grid_place( void *p, size_t a, size_t b )
+{
+    #ifdef GRID_NODES
+    struct grid_head *h;        /*< The front of the grid. */
+    unsigned long mask[16];     /*< The nodes to keep them on. */
+    unsigned int cpu, node;     /*< Where we are running. */
+    size_t bits = sizeof(long) * CHAR_BIT;  /*< Nodes in a word of mask. */
+
+    h = (struct grid_head *) ( (char *) p - GRID_HEAD );
+    if ( !binding || h->page != GRID_PAGE || h->file ||
+         syscall( SYS_getcpu, &cpu, &node, NULL ) != 0 ||
+         node >= bits*16 - 1 )
+        return;
+
+    a = ( GRID_HEAD + a + GRID_PAGE - 1 ) / GRID_PAGE * GRID_PAGE;
+    b = ( GRID_HEAD + b ) / GRID_PAGE * GRID_PAGE;
+    if ( a >= b )
+        return;
+
+    memset( mask, 0, sizeof(mask) );
+    mask[ node / bits ] = 1UL << ( node % bits );
+    syscall( SYS_mbind, (char *) h + a, b - a, GRID_PREFERRED, mask,
+             bits*16, 0 );
+    #else
+    (void) p;
+    (void) a;
+    (void) b;
+    #endif
+}
@@ -0,0 +1,44 @@
+/*
+ *  HackOfLife - grids.h
+ *  Copyright (c) 2009  Barry "Ishara" Peddycord - http://isharacomix.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GRIDS_H
+#define __GRIDS_H
+
+#include <stddef.h>
+
+
+/* Getting memory for a board, and giving it back. */
+void *grid_alloc( size_t n );
+void grid_free( void *p );
+
+/* Emptying it between games. */
+void grid_clear( void *p, size_t a, size_t b );
+
+/* Keeping a board in a file. */
+void *grid_map( const char *name, size_t hn, size_t n, int k, int fresh,
+                char **grids );
+void grid_ahead( const void *p, size_t n );
+void grid_sync( int front );
+
+/* Keeping it next to the threads that work on it. */
+int grid_bind( int on );
+void grid_place( void *p, size_t a, size_t b );
+
+
+#endif /* __GRIDS_H */
+
@@ -0,0 +1,437 @@
+/*
+ *  HackOfLife - hashlife.c
+ *  Copyright (c) 2009  Barry "Ishara" Peddycord - http://isharacomix.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  HashLife, for jumping a deterministic board thousands of generations
+ *  ahead. The board is stored as a quadtree where every square that looks
+ *  the same is the same node, and every node remembers what its middle
+ *  looks like some number of generations later. Boards full of still lifes,
+ *  blinkers and empty space repeat themselves so much that most of the work
+ *  is looked up rather than done.
+ *
+ *  The board is copied into a square universe twice its size, worked on,
+ *  and copied back. Cells off the edge of a board that doesn't wrap are
+ *  outside cells, which never change and never count as neighbors. Boards
+ *  that wrap get copies of their opposite edges around them instead, as deep
+ *  as the light can travel during the jump, so those jumps are kept to half
+ *  the size of the board.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "game.h"
+#include "hashlife.h"
+
+
+#define HL_OUTSIDE  19          /*< The state of cells off the board. */
+#define HL_CELLS    32          /*< Node numbers below this are cells. */
+#define HL_LEVELS   32          /*< The most levels a tree can have. */
+#define HL_START    (1<<16)     /*< The number of nodes we start with. */
+#define HL_MAX      (1<<21)     /*< The most nodes we will ever keep. */
+
+/* A square of 2^level cells on a side, made of four squares half as big.
+   Level 1 squares are made of cells. */
+struct hl_node
+{
+    int q[4];                   /*< The NW, NE, SW and SE quarters. */
+    int res;                    /*< The middle 2^(level-2) generations
+                                        later, or 0 if not known yet. */
+    int sres;                   /*< The middle 2^sj generations later. */
+    int next;                   /*< The next node in the hash chain. */
+    char sj;                    /*< Which jump sres is for. */
+    char level;                 /*< The size of the square. */
+};
+
+static struct hl_node *nodes = NULL;    /*< Every node there is. */
+static int *table = NULL;       /*< Hash chains of the nodes. */
+static int cap;                 /*< Room for this many nodes. */
+static int used;                /*< The next free node. */
+static int full;                /*< Did we run out of room? */
+static int outside[HL_LEVELS];  /*< Squares of nothing but outside cells. */
+
+static int (*hrule)( const char * );    /*< Works out a cell's next state. */
+static char *hgrid;             /*< The board being worked on. */
+static int hw, hh, hpitch;      /*< Its size and the distance between rows. */
+static int hwrap;               /*< Does it wrap? */
+static long ox, oy;             /*< Where the board sits in the universe. */
+static long margin;             /*< How far the wrapped copies reach. */
+
+
+/* Find the node made of the four quarters, making it if it's new. When we
+   run out of room, we hand back nonsense and let the caller start over. */
+static int hl_find( int level, int nw, int ne, int sw, int se )
+{
+    unsigned long k;            /*< The hash. */
+    int i, j;                   /*< Iterators. */
+    struct hl_node *n;          /*< Resized node pool... */
+    int *t;                     /*< ...and hash table. */
+
+    k = ( (unsigned long) nw * 5 + (unsigned long) ne * 17 +
+          (unsigned long) sw * 257 + (unsigned long) se * 65537 +
+          (unsigned long) level ) * 2654435761UL;
+    for ( i = table[ ( k >> 8 ) & ( cap-1 ) ]; i; i = nodes[i].next )
+    {
+        if ( nodes[i].q[0] == nw && nodes[i].q[1] == ne &&
+             nodes[i].q[2] == sw && nodes[i].q[3] == se &&
+             nodes[i].level == level )
+            return i;
+    }
+
+    /* Make more room, and hash everything again. */
+    if ( used == cap )
+    {
+        if ( full || cap >= HL_MAX )
+        {
+            full = 1;
+            return outside[ level ];
+        }
+
+        t = calloc( sizeof(int), cap*2 );
+        n = ( t != NULL ) ? realloc( nodes, sizeof(struct hl_node)*cap*2 )
+                          : NULL;
+        if ( n == NULL )
+        {
+            if ( t != NULL ) free( t );
+            full = 1;
+            return outside[ level ];
+        }
+        nodes = n;
+        free( table );
+        table = t;
+        cap *= 2;
+
+        for ( i = HL_CELLS; i < used; i++ )
+        {
+            k = ( (unsigned long) nodes[i].q[0] * 5 +
+                  (unsigned long) nodes[i].q[1] * 17 +
+                  (unsigned long) nodes[i].q[2] * 257 +
+                  (unsigned long) nodes[i].q[3] * 65537 +
+                  (unsigned long) nodes[i].level ) * 2654435761UL;
+            j = (int) ( ( k >> 8 ) & ( cap-1 ) );
+            nodes[i].next = table[j];
+            table[j] = i;
+        }
+    }
+
+    i = used++;
+    nodes[i].q[0] = nw;
+    nodes[i].q[1] = ne;
+    nodes[i].q[2] = sw;
+    nodes[i].q[3] = se;
+    nodes[i].res = 0;
+    nodes[i].sres = 0;
+    nodes[i].sj = -1;
+    nodes[i].level = level;
+    nodes[i].next = table[ ( k >> 8 ) & ( cap-1 ) ];
+    table[ ( k >> 8 ) & ( cap-1 ) ] = i;
+    return i;
+}
+
+
+/* Forget every node. Returns 0 if there is no memory for a new pool. */
+static int hl_reset( void )
+{
+    int i;                      /*< Iterator. */
+
+    if ( nodes == NULL || table == NULL )
+    {
+        hl_free();
+        nodes = malloc( sizeof(struct hl_node)*HL_START );
+        table = malloc( sizeof(int)*HL_START );
+        if ( nodes == NULL || table == NULL )
+        {
+            hl_free();
+            return 0;
+        }
+        cap = HL_START;
+    }
+
+    memset( table, 0, sizeof(int)*cap );
+    used = HL_CELLS;
+    full = 0;
+
+    outside[0] = HL_OUTSIDE;
+    for ( i = 1; i < HL_LEVELS; i++ )
+        outside[i] = hl_find( i, outside[i-1], outside[i-1], outside[i-1],
+                              outside[i-1] );
+    return !full;
+}
+
+
+/* Release all of the nodes. */
+void hl_free( void )
+{
+    if ( nodes != NULL ) free( nodes );
+    if ( table != NULL ) free( table );
+
+    nodes = NULL;
+    table = NULL;
+    cap = 0;
+    used = 0;
+}
+
+
+/* The cell at x,y of the universe. */
+static int hl_cell( long x, long y )
+{
+    x -= ox;
+    y -= oy;
+
+    if ( hwrap )
+    {
+        if ( x < -margin || x >= hw + margin ||
+             y < -margin || y >= hh + margin )
+            return HL_OUTSIDE;
+        x = ( ( x % hw ) + hw ) % hw;
+        y = ( ( y % hh ) + hh ) % hh;
+    }
+    else if ( x < 0 || x >= hw || y < 0 || y >= hh )
+        return HL_OUTSIDE;
+
+    return hgrid[ (size_t) y*hpitch + x ];
+}
+
+
+/* Build the square of the universe at x,y of the given level. */
+static int hl_build( long x, long y, int level )
+{
+    long s = 1L << level;       /*< The size of the square. */
+    long lo = ( hwrap ) ? margin : 0;   /*< The reach of the cells. */
+
+    /* Skip the parts with nothing but outside cells. */
+    if ( x + s <= ox - lo || x >= ox + hw + lo ||
+         y + s <= oy - lo || y >= oy + hh + lo )
+        return outside[ level ];
+
+    if ( level == 1 )
+        return hl_find( 1, hl_cell( x, y ), hl_cell( x+1, y ),
+                        hl_cell( x, y+1 ), hl_cell( x+1, y+1 ) );
+
+    s /= 2;
+    return hl_find( level, hl_build( x, y, level-1 ),
+                    hl_build( x+s, y, level-1 ),
+                    hl_build( x, y+s, level-1 ),
+                    hl_build( x+s, y+s, level-1 ) );
+}
+
+
+/* Copy the square of the universe at x,y back onto the board. */
+static void hl_write( int p, long x, long y, int level )
+{
+    long s = 1L << level;       /*< The size of the square. */
+
+    if ( x + s <= ox || x >= ox + hw || y + s <= oy || y >= oy + hh )
+        return;
+
+    if ( level == 0 )
+    {
+        hgrid[ (size_t) ( y-oy )*hpitch + x-ox ] = (char) p;
+        return;
+    }
+
+    s /= 2;
+    hl_write( nodes[p].q[0], x, y, level-1 );
+    hl_write( nodes[p].q[1], x+s, y, level-1 );
+    hl_write( nodes[p].q[2], x, y+s, level-1 );
+    hl_write( nodes[p].q[3], x+s, y+s, level-1 );
+}
+
+
+/* The middle 2x2 of a 4x4 square one generation later. */
+static int hl_leaf( int p )
+{
+    char g[4][4];               /*< The cells. */
+    char around[9];             /*< A cell and its neighbors. */
+    int r[4];                   /*< The new cells. */
+    int i, j, x, y;             /*< Iterators. */
+
+    for ( i = 0; i < 4; i++ )
+    {
+        for ( j = 0; j < 4; j++ )
+            g[ (i/2)*2 + j/2 ][ (i%2)*2 + j%2 ] =
+                (char) nodes[ nodes[p].q[i] ].q[j];
+    }
+
+    for ( i = 0; i < 4; i++ )
+    {
+        y = 1 + i/2;
+        x = 1 + i%2;
+        if ( g[y][x] == HL_OUTSIDE )
+        {
+            r[i] = HL_OUTSIDE;
+            continue;
+        }
+
+        for ( j = 0; j < 9; j++ )
+        {
+            around[j] = g[ y-1 + j/3 ][ x-1 + j%3 ];
+            if ( around[j] == HL_OUTSIDE )
+                around[j] = 0;
+        }
+        r[i] = hrule( around );
+    }
+
+    return hl_find( 1, r[0], r[1], r[2], r[3] );
+}
+
+
+/* The middle of node p, 2^j generations later, where j is at most two less
+   than the level of p. Squares are put back together out of the answers for
+   the nine overlapping squares half as big, and remembered. */
+static int hl_step( int p, int j )
+{
+    int level = nodes[p].level; /*< The size of p. */
+    int big = ( j == level-2 ); /*< Is this the biggest jump p can do? */
+    int g[4][4];                /*< p in sixteenths. */
+    int s[3][3];                /*< The nine overlapping squares. */
+    int t[2][2];                /*< The four overlapping squares... */
+    int u[2][2];                /*< ...and their middles, further along. */
+    int a, b, i, m;             /*< Iterators. */
+
+    if ( level == 2 )
+    {
+        /* hl_leaf() can move the nodes, so don't store straight into them. */
+        if ( nodes[p].res == 0 )
+        {
+            m = hl_leaf( p );
+            nodes[p].res = m;
+        }
+        return nodes[p].res;
+    }
+    if ( big && nodes[p].res )
+        return nodes[p].res;
+    if ( !big && nodes[p].sj == j && nodes[p].sres )
+        return nodes[p].sres;
+
+    for ( i = 0; i < 4; i++ )
+    {
+        for ( a = 0; a < 4; a++ )
+            g[ (i/2)*2 + a/2 ][ (i%2)*2 + a%2 ] = nodes[ nodes[p].q[i] ].q[a];
+    }
+
+    /* The nine squares, either moved along as far as they go or just cut
+       down to their middles. */
+    for ( a = 0; a < 3; a++ )
+    {
+        for ( b = 0; b < 3; b++ )
+        {
+            m = hl_find( level-1, g[a][b], g[a][b+1], g[a+1][b],
+                         g[a+1][b+1] );
+            if ( big )
+                s[a][b] = hl_step( m, level-3 );
+            else
+                s[a][b] = hl_find( level-2,
+                                   nodes[ nodes[m].q[0] ].q[3],
+                                   nodes[ nodes[m].q[1] ].q[2],
+                                   nodes[ nodes[m].q[2] ].q[1],
+                                   nodes[ nodes[m].q[3] ].q[0] );
+        }
+    }
+
+    for ( a = 0; a < 2; a++ )
+    {
+        for ( b = 0; b < 2; b++ )
+        {
+            t[a][b] = hl_find( level-1, s[a][b], s[a][b+1], s[a+1][b],
+                               s[a+1][b+1] );
+            u[a][b] = hl_step( t[a][b], ( big ) ? level-3 : j );
+        }
+    }
+
+    m = hl_find( level-1, u[0][0], u[0][1], u[1][0], u[1][1] );
+    if ( big )
+        nodes[p].res = m;
+    else
+    {
+        nodes[p].sres = m;
+        nodes[p].sj = (char) j;
+    }
+    return m;
+}
+
+
+/* Jump the w by h board in grid gens generations ahead. rule is given a
+   cell and its neighbors as three rows of three, and returns the cell's next
+   state. Returns the number of generations actually done, which is less than
+   gens if we ran out of memory. */
+long hl_generations( char *grid, int w, int h, int pitch, int wrap,
+                     long gens, int (*rule)( const char *cells ) )
+{
+    long done = 0;              /*< Generations done so far. */
+    long size;                  /*< The size of the universe. */
+    int level, top;             /*< Its level, and the biggest jump. */
+    int j, p;                   /*< The jump and the universe. */
+
+    hgrid = grid;
+    hw = w;
+    hh = h;
+    hpitch = pitch;
+    hwrap = wrap;
+    hrule = rule;
+
+    /* The board fills at most the middle half of the universe. */
+    for ( level = 2; ( 1L << level ) < 2L * MAX( w, h ); level++ ){};
+    size = 1L << level;
+    ox = size / 4;
+    oy = size / 4;
+
+    top = level-2;
+    if ( wrap )
+    {
+        while ( top > 0 && ( 1L << top ) > MIN( w, h ) / 2 )
+            top--;
+    }
+
+    /* The rules may have changed since last time, so nothing we remember
+       can be trusted. */
+    if ( !hl_reset() )
+        return 0;
+
+    while ( done < gens )
+    {
+        for ( j = top; j > 0 && ( 1L << j ) > gens - done; j-- ){};
+        margin = 1L << j;
+
+        /* Start over when the pool is half full, so one jump can't run
+           out of room part way through. */
+        if ( used > HL_MAX / 2 && !hl_reset() )
+            break;
+
+        p = hl_build( 0, 0, level );
+        if ( !full )
+            p = hl_step( p, j );
+
+        if ( full )
+        {
+            /* Try again with a smaller jump. */
+            if ( !hl_reset() || j == 0 )
+                break;
+            top = j-1;
+            continue;
+        }
+
+        hl_write( p, size/4, size/4, level-1 );
+        done += 1L << j;
+    }
+
+    return done;
+}
+
@@ -0,0 +1,30 @@
+/*
+ *  HackOfLife - hashlife.h
+ *  Copyright (c) 2009  Barry "Ishara" Peddycord - http://isharacomix.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HASHLIFE_H
+#define __HASHLIFE_H
+
+
+/* Jumping deterministic boards far ahead. */
+long hl_generations( char *grid, int w, int h, int pitch, int wrap,
+                     long gens, int (*rule)( const char *cells ) );
+void hl_free( void );
+
+
+#endif /* __HASHLIFE_H */
+
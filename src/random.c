@@ -36,6 +36,9 @@
  *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <limits.h>
+#include <string.h>
+
 #include "random.h"
 
 /* Period parameters */  
@@ -47,8 +50,12 @@
 
 
 static unsigned long mt[N]; /* the array for the state vector  */
+static unsigned long out[N]; /* the tempered state, handed out in order */
 static int mti=N+1; /* mti==N+1 means mt[N] is not initialized */
 
+static void philox_mul(unsigned long a, unsigned long b,
+                       unsigned long *hi, unsigned long *lo);
+
 
 /* initializes mt[N] with a seed */
 void init_genrand(unsigned long s)
@@ -97,42 +104,91 @@ void init_by_array(unsigned long init_key[], int key_length)
 }
 
 
+/* generates N words at one time and tempers all of them. The twist is
+   written without a table lookup, so the compiler is free to turn the loops
+   into vector code. */
+static void mt_refill(void)
+{
+    unsigned long y;
+    int kk;
+
+    if (mti == N+1)   /* if init_genrand() has not been called, */
+        init_genrand(5489UL); /* a default initial seed is used */
+
+    for (kk=0;kk<N-M;kk++) {
+        y = (mt[kk]&UPPER_MASK)|(mt[kk+1]&LOWER_MASK);
+        mt[kk] = mt[kk+M] ^ (y >> 1) ^ ((0UL - (y & 0x1UL)) & MATRIX_A);
+    }
+    for (;kk<N-1;kk++) {
+        y = (mt[kk]&UPPER_MASK)|(mt[kk+1]&LOWER_MASK);
+        mt[kk] = mt[kk+(M-N)] ^ (y >> 1) ^ ((0UL - (y & 0x1UL)) & MATRIX_A);
+    }
+    y = (mt[N-1]&UPPER_MASK)|(mt[0]&LOWER_MASK);
+    mt[N-1] = mt[M-1] ^ (y >> 1) ^ ((0UL - (y & 0x1UL)) & MATRIX_A);
+
+    /* Tempering */
+    for (kk=0;kk<N;kk++) {
+        y = mt[kk];
+        y ^= (y >> 11);
+        y ^= (y << 7) & 0x9d2c5680UL;
+        y ^= (y << 15) & 0xefc60000UL;
+        y ^= (y >> 18);
+        out[kk] = y;
+    }
+
+    mti = 0;
+}
+
+
 /* generates a random number on [0,0xffffffff]-interval */
 unsigned long rnd_32int(void)
 {
-    unsigned long y;
-    static unsigned long mag01[2]={0x0UL, MATRIX_A};
-    /* mag01[x] = x * MATRIX_A  for x=0,1 */
+    if (mti >= N)
+        mt_refill();
 
-    if (mti >= N) { /* generate N words at one time */
-        int kk;
+    return out[mti++];
+}
 
-        if (mti == N+1)   /* if init_genrand() has not been called, */
-            init_genrand(5489UL); /* a default initial seed is used */
 
-        for (kk=0;kk<N-M;kk++) {
-            y = (mt[kk]&UPPER_MASK)|(mt[kk+1]&LOWER_MASK);
-            mt[kk] = mt[kk+M] ^ (y >> 1) ^ mag01[y & 0x1UL];
-        }
-        for (;kk<N-1;kk++) {
-            y = (mt[kk]&UPPER_MASK)|(mt[kk+1]&LOWER_MASK);
-            mt[kk] = mt[kk+(M-N)] ^ (y >> 1) ^ mag01[y & 0x1UL];
-        }
-        y = (mt[N-1]&UPPER_MASK)|(mt[0]&LOWER_MASK);
-        mt[N-1] = mt[M-1] ^ (y >> 1) ^ mag01[y & 0x1UL];
+/* fills buf with n random numbers on [0,0xffffffff]-interval, the same ones
+   that n calls to rnd_32int() would give, copying whole runs of the
+   tempered state at a time. */
+void rnd_block(unsigned long *buf, int n)
+{
+    int k;
+
+    while (n > 0) {
+        if (mti >= N)
+            mt_refill();
 
-        mti = 0;
+        k = (n < N-mti) ? n : N-mti;
+        memcpy(buf, out+mti, sizeof(unsigned long)*k);
+
+        mti += k;
+        buf += k;
+        n -= k;
     }
-  
-    y = mt[mti++];
+}
 
-    /* Tempering */
-    y ^= (y >> 11);
-    y ^= (y << 7) & 0x9d2c5680UL;
-    y ^= (y << 15) & 0xefc60000UL;
-    y ^= (y >> 18);
 
-    return y;
+/* fills buf with n random numbers on [0,bound-1]-interval. Each number is
+   multiplied by bound and the top 32 bits of the product kept, so there is
+   no division. Products whose bottom half is below 2^32 mod bound would
+   favor some values, so those numbers are thrown out and drawn again (96
+   in 2^32 of them for a bound of 100), and every value is equally likely.
+   bound must be positive and fit in 32 bits. */
+void rnd_below(unsigned long *buf, int n, unsigned long bound)
+{
+    unsigned long thr = (0xffffffffUL % bound + 1) % bound;
+    unsigned long lo;
+    int i;
+
+    rnd_block(buf, n);
+    for (i = 0; i < n; i++) {
+        philox_mul(buf[i], bound, &buf[i], &lo);
+        while (lo < thr)
+            philox_mul(rnd_32int(), bound, &buf[i], &lo);
+    }
 }
 
 
@@ -175,3 +231,93 @@ double rnd_real53(void)
 } 
 /* These real versions are due to Isaku Wada, 2002/01/09 added */
 
+
+/* Counter-based generation (Philox4x32-10, from "Parallel Random Numbers:
+   As Easy as 1, 2, 3" by Salmon et al). Instead of stepping a state, every
+   block of numbers is scrambled out of its own counter, so the same seed,
+   generation and cell always give the same numbers no matter who asks or in
+   what order. */
+#define PHILOX_M0 0xD2511F53UL  /* round multipliers */
+#define PHILOX_M1 0xCD9E8D57UL
+#define PHILOX_W0 0x9E3779B9UL  /* key bumps (golden ratio, sqrt(3)-1) */
+#define PHILOX_W1 0xBB67AE85UL
+
+/* hi and lo get the top and bottom halves of the 64-bit product a*b */
+static void philox_mul(unsigned long a, unsigned long b,
+                       unsigned long *hi, unsigned long *lo)
+{
+#if ULONG_MAX > 0xffffffffUL
+    unsigned long p = a * b;
+    *hi = p >> 32;
+    *lo = p & 0xffffffffUL;
+#else
+    unsigned long al = a & 0xffffUL, ah = a >> 16;
+    unsigned long bl = b & 0xffffUL, bh = b >> 16;
+    unsigned long ll = al*bl, lh = al*bh, hl = ah*bl, hh = ah*bh;
+    unsigned long mid = (ll >> 16) + (lh & 0xffffUL) + (hl & 0xffffUL);
+    *lo = (ll & 0xffffUL) | ((mid & 0xffffUL) << 16);
+    *hi = hh + (lh >> 16) + (hl >> 16) + (mid >> 16);
+#endif
+}
+
+/* scrambles the counter of block round of the cells cell to cell+3 of
+   generation gen into four numbers. Boards past 2^34 cells carry the rest
+   of cell into the second word. */
+static void philox(unsigned long seed, unsigned long gen, unsigned long cell,
+                   unsigned long round, unsigned long out[4])
+{
+    unsigned long c0 = (cell >> 2) & 0xffffffffUL;
+    unsigned long c1 = (cell >> 17 >> 17) & 0xffffffffUL;
+    unsigned long c2 = gen & 0xffffffffUL, c3 = round & 0xffffffffUL;
+    unsigned long k0 = seed & 0xffffffffUL, k1 = 0;
+    unsigned long hi0, lo0, hi1, lo1;
+    int i;
+
+    for (i = 0; i < 10; i++) {
+        philox_mul(PHILOX_M0, c0, &hi0, &lo0);
+        philox_mul(PHILOX_M1, c2, &hi1, &lo1);
+        c0 = hi1 ^ c1 ^ k0;
+        c1 = lo1;
+        c2 = hi0 ^ c3 ^ k1;
+        c3 = lo0;
+        k0 = (k0 + PHILOX_W0) & 0xffffffffUL;
+        k1 = (k1 + PHILOX_W1) & 0xffffffffUL;
+    }
+
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+/* generates four random numbers on [0,0xffffffff]-interval for the cells
+   cell to cell+3 of a generation, where cell is a multiple of 4. */
+void rnd_cells(unsigned long seed, unsigned long gen, unsigned long cell,
+               unsigned long out[4])
+{
+    philox(seed, gen, cell, 0, out);
+}
+
+/* generates four random numbers on [0,bound-1]-interval for the same cells,
+   taking the numbers rnd_cells() gives to the bound the way rnd_below()
+   does. A number that has to be thrown out is drawn again from the next
+   block of the cells' counter, so the numbers still only depend on the
+   seed, generation and cell. */
+void rnd_cells_below(unsigned long seed, unsigned long gen, unsigned long cell,
+                     unsigned long bound, unsigned long out[4])
+{
+    unsigned long thr = (0xffffffffUL % bound + 1) % bound;
+    unsigned long lo[4], more[4], round;
+    int i;
+
+    philox(seed, gen, cell, 0, out);
+    for (i = 0; i < 4; i++)
+        philox_mul(out[i], bound, &out[i], &lo[i]);
+
+    for (i = 0; i < 4; i++) {
+        for (round = 1; lo[i] < thr; round++) {
+            philox(seed, gen, cell, round, more);
+            philox_mul(more[i], bound, &out[i], &lo[i]);
+        }
+    }
+}
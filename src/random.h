@@ -47,6 +47,8 @@ void init_by_array(unsigned long init_key[], int key_length);
 /* Random integer generation. */
 unsigned long rnd_32int(void);
 long rnd_31int(void);
+void rnd_block(unsigned long *buf, int n);
+void rnd_below(unsigned long *buf, int n, unsigned long bound);
 
 /* Random real number generation. */
 double rnd_r1(void); /* [0,1] */
@@ -54,6 +56,12 @@ double rnd_r2(void); /* [0,1) */
 double rnd_r3(void); /* (0,1) */
 double rnd_real53(void); /* [0,1) with 53-bit resolution */
 
+/* Counter-based random integer generation. */
+void rnd_cells(unsigned long seed, unsigned long gen, unsigned long cell,
+               unsigned long out[4]);
+void rnd_cells_below(unsigned long seed, unsigned long gen, unsigned long cell,
+                     unsigned long bound, unsigned long out[4]);
+
 
 #endif /* __RANDOM_H */
 
@@ -0,0 +1,333 @@
+/*
+ *  HackOfLife - sparse.c
+ *  Copyright (c) 2009  Barry "Ishara" Peddycord - http://isharacomix.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  The sparse engine, for boards far too big to keep every cell of. Only
+ *  the cells that aren't empty are kept, in a hash table keyed by where they
+ *  are. A generation adds the counters of every live cell to its neighbors
+ *  in a second table, so only the cells next to something are ever looked
+ *  at, no matter how big the board is.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "game.h"
+#include "sparse.h"
+
+
+#define SP_START    1024        /*< The number of slots a table starts with. */
+
+/* A slot in a table. */
+struct sp_cell
+{
+    unsigned long x, y;         /*< Where the cell is. */
+    unsigned long n;            /*< The counters of its neighbors, while a
+                                        generation is being worked out. */
+    char v;                     /*< The cell, or 0 if it was emptied. */
+    char used;                  /*< Is the slot taken? */
+};
+
+/* A table of cells, with a power of two slots and at least half of them
+   free, so a cell is always found a few slots from where it hashes to. */
+struct sp_table
+{
+    struct sp_cell *slots;      /*< The slots. */
+    unsigned long cap;          /*< How many there are... */
+    unsigned long count;        /*< ...and how many are taken. */
+};
+
+static struct sp_table board;   /*< The cells of the board. */
+static struct sp_table work;    /*< Every cell that might change. */
+static unsigned long sw, sh;    /*< The size of the board. */
+static int swrap;               /*< Does it wrap? */
+
+
+/* The slot cell x,y is in, or the free slot it would go in. */
+static struct sp_cell *sp_slot( struct sp_table *t, unsigned long x,
+                                unsigned long y )
+{
+    unsigned long k;            /*< The hash. */
+
+    k = ( x * 2654435761UL + y ) & 0xffffffffUL;
+    k ^= k >> 16;
+    k = ( k * 0x85ebca6bUL ) & 0xffffffffUL;
+    k ^= k >> 13;
+    k = ( k * 0xc2b2ae35UL ) & 0xffffffffUL;
+    k ^= k >> 16;
+
+    k &= t->cap - 1;
+    while ( t->slots[k].used && ( t->slots[k].x != x || t->slots[k].y != y ) )
+        k = ( k + 1 ) & ( t->cap - 1 );
+    return t->slots + k;
+}
+
+
+/* Make room in the table for n cells in all. Returns 0 if we ran out of
+   memory, in which case the table is left alone. */
+static int sp_fit( struct sp_table *t, unsigned long n )
+{
+    struct sp_table old = *t;   /*< The table we are moving out of. */
+    unsigned long i;            /*< Iterator. */
+
+    while ( n * 2 > t->cap )
+        t->cap *= 2;
+    if ( t->cap == old.cap )
+        return 1;
+
+    t->slots = calloc( sizeof(struct sp_cell), t->cap );
+    if ( t->slots == NULL )
+    {
+        *t = old;
+        return 0;
+    }
+
+    for ( i = 0; i < old.cap; i++ )
+    {
+        if ( old.slots[i].used )
+            *sp_slot( t, old.slots[i].x, old.slots[i].y ) = old.slots[i];
+    }
+    free( old.slots );
+    return 1;
+}
+
+
+/* The slot of cell x,y, taking a new one for it if it has none. Returns
+   NULL if we ran out of memory. */
+static struct sp_cell *sp_add( struct sp_table *t, unsigned long x,
+                               unsigned long y )
+{
+    struct sp_cell *c;          /*< The slot. */
+
+    if ( !sp_fit( t, t->count+1 ) )
+        return NULL;
+
+    c = sp_slot( t, x, y );
+    if ( !c->used )
+    {
+        c->x = x;
+        c->y = y;
+        c->n = 0;
+        c->v = 0;
+        c->used = 1;
+        t->count++;
+    }
+    return c;
+}
+
+
+/* Empty the table. */
+static void sp_clear( struct sp_table *t )
+{
+    memset( t->slots, 0, sizeof(struct sp_cell)*t->cap );
+    t->count = 0;
+}
+
+
+/* Set up an empty w by h board. Returns 0 if we ran out of memory. */
+int sp_reset( unsigned long w, unsigned long h, int wrap )
+{
+    sp_free();
+    sw = w;
+    sh = h;
+    swrap = wrap;
+
+    board.slots = calloc( sizeof(struct sp_cell), SP_START );
+    work.slots = calloc( sizeof(struct sp_cell), SP_START );
+    if ( board.slots == NULL || work.slots == NULL )
+    {
+        sp_free();
+        return 0;
+    }
+    board.cap = SP_START;
+    work.cap = SP_START;
+    return 1;
+}
+
+
+/* Release the board. */
+void sp_free( void )
+{
+    if ( board.slots != NULL ) free( board.slots );
+    if ( work.slots != NULL ) free( work.slots );
+
+    memset( &board, 0, sizeof(struct sp_table) );
+    memset( &work, 0, sizeof(struct sp_table) );
+}
+
+
+/* The cell at x,y. */
+int sp_get( unsigned long x, unsigned long y )
+{
+    struct sp_cell *c;          /*< Its slot. */
+
+    if ( board.slots == NULL )
+        return 0;
+
+    c = sp_slot( &board, x, y );
+    return ( c->used ) ? c->v : 0;
+}
+
+
+/* Change the cell at x,y to v. Emptied cells keep their slot until the next
+   generation. Returns 0 if we ran out of memory. */
+int sp_set( unsigned long x, unsigned long y, int v )
+{
+    struct sp_cell *c;          /*< Its slot. */
+
+    if ( board.slots == NULL )
+        return 0;
+
+    c = ( v ) ? sp_add( &board, x, y ) : sp_slot( &board, x, y );
+    if ( c == NULL )
+        return 0;
+
+    if ( c->used )
+        c->v = (char) v;
+    return 1;
+}
+
+
+/* A hash of every cell on the board. The cells are added up in whatever
+   order they sit in the table, so two equal boards hash the same. */
+unsigned long sp_hash( void )
+{
+    unsigned long h = 0, k;     /*< The hash, and the hash of a cell. */
+    unsigned long i;            /*< Iterator. */
+    struct sp_cell *c;          /*< A slot on the board. */
+
+    for ( i = 0; i < board.cap; i++ )
+    {
+        c = board.slots + i;
+        if ( !c->used || !c->v )
+            continue;
+
+        k = ( ( c->x * 2654435761UL + c->y ) * 40503UL + c->v )
+            & 0xffffffffUL;
+        k ^= k >> 16;
+        k = ( k * 0x85ebca6bUL ) & 0xffffffffUL;
+        k ^= k >> 13;
+        k = ( k * 0xc2b2ae35UL ) & 0xffffffffUL;
+        k ^= k >> 16;
+        h += k;
+    }
+    return h;
+}
+
+
+/* Hand every cell that isn't empty to visit, in no particular order. */
+void sp_visit( void (*visit)( unsigned long x, unsigned long y, int v ) )
+{
+    unsigned long i;            /*< Iterator. */
+    struct sp_cell *c;          /*< A slot on the board. */
+
+    for ( i = 0; i < board.cap; i++ )
+    {
+        c = board.slots + i;
+        if ( c->used && c->v )
+            visit( c->x, c->y, c->v );
+    }
+}
+
+
+/* Work out the next generation. counter holds the packed neighbor counter
+   of every kind of cell, and rule is handed every cell that isn't empty or
+   is next to a live cell, along with the sum of its neighbors' counters, and
+   returns its next state. Cells that are empty with no live neighbors stay
+   that way. Returns 0 if we ran out of memory, in which case the board is
+   left as it was. */
+int sp_generation( const unsigned long *counter,
+                   int (*rule)( unsigned long x, unsigned long y, int v,
+                                unsigned long n ) )
+{
+    unsigned long i, k;         /*< Iterator and the cell's counter. */
+    unsigned long xs[3], ys[3]; /*< The columns and rows around the cell. */
+    int a, b, v;                /*< Iterators and the next state. */
+    struct sp_cell *c, *d;      /*< Slots on the board and in the work. */
+
+    if ( board.slots == NULL )
+        return 0;
+
+    /* Every cell on the board is looked at, and every live one adds its
+       counter to its neighbors. Off the edge of a board that doesn't wrap,
+       there are no neighbors to add to. */
+    sp_clear( &work );
+    for ( i = 0; i < board.cap; i++ )
+    {
+        c = board.slots + i;
+        if ( !c->used || !c->v )
+            continue;
+
+        d = sp_add( &work, c->x, c->y );
+        if ( d == NULL )
+            return 0;
+        d->v = c->v;
+
+        k = counter[ (int) c->v ];
+        if ( !k )
+            continue;
+
+        xs[0] = ( c->x > 0 ) ? c->x-1 : ( swrap ) ? sw-1 : sw;
+        xs[1] = c->x;
+        xs[2] = ( c->x < sw-1 ) ? c->x+1 : ( swrap ) ? 0 : sw;
+        ys[0] = ( c->y > 0 ) ? c->y-1 : ( swrap ) ? sh-1 : sh;
+        ys[1] = c->y;
+        ys[2] = ( c->y < sh-1 ) ? c->y+1 : ( swrap ) ? 0 : sh;
+        for ( a = 0; a < 3; a++ )
+        {
+            for ( b = 0; b < 3; b++ )
+            {
+                if ( ( a == 1 && b == 1 ) || xs[b] == sw || ys[a] == sh )
+                    continue;
+
+                d = sp_add( &work, xs[b], ys[a] );
+                if ( d == NULL )
+                    return 0;
+                d->n += k;
+            }
+        }
+    }
+
+    /* Make sure the new board fits before the old one is thrown out. */
+    if ( !sp_fit( &board, work.count ) )
+        return 0;
+
+    sp_clear( &board );
+    for ( i = 0; i < work.cap; i++ )
+    {
+        d = work.slots + i;
+        if ( !d->used )
+            continue;
+
+        v = rule( d->x, d->y, d->v, d->n );
+        if ( v )
+        {
+            c = sp_slot( &board, d->x, d->y );
+            c->x = d->x;
+            c->y = d->y;
+            c->n = 0;
+            c->v = (char) v;
+            c->used = 1;
+            board.count++;
+        }
+    }
+    return 1;
+}
+
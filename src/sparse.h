@@ -0,0 +1,46 @@
+/*
+ *  HackOfLife - sparse.h
+ *  Copyright (c) 2009  Barry "Ishara" Peddycord - http://isharacomix.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SPARSE_H
+#define __SPARSE_H
+
+#include <limits.h>
+
+
+/* The biggest board the sparse engine can hold, in cells a side. The game
+   keeps cells in ints, so this leaves room to step past the edge. */
+#define SP_MAX      ( INT_MAX / 2 )
+
+/* Setting up a sparse board. */
+int sp_reset( unsigned long w, unsigned long h, int wrap );
+void sp_free( void );
+
+/* Looking at and changing its cells. */
+int sp_get( unsigned long x, unsigned long y );
+int sp_set( unsigned long x, unsigned long y, int v );
+unsigned long sp_hash( void );
+void sp_visit( void (*visit)( unsigned long x, unsigned long y, int v ) );
+
+/* Moving it along a generation. */
+int sp_generation( const unsigned long *counter,
+                   int (*rule)( unsigned long x, unsigned long y, int v,
+                                unsigned long n ) );
+
+
+#endif /* __SPARSE_H */
+
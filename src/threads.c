@@ -0,0 +1,334 @@
+/*
+ *  HackOfLife - threads.c
+ *  Copyright (c) 2009  Barry "Ishara" Peddycord - http://isharacomix.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  A tiny pool of worker threads for the generation engines. The main
+ *  thread is always worker 0 and does its share of every job, so a pool of
+ *  one thread is just a plain function call. Jobs split the board into
+ *  bands of rows and meet at threads_wait() between passes. A job can also
+ *  be run in the background, with one more thread standing in for the main
+ *  one. Systems without POSIX threads always get a pool of one, and run
+ *  background jobs right away.
+ *
+ *  When asked to, and where the system lets us, every thread of a pool of
+ *  more than one is kept on a processor of its own. A worker always gets the same band of
+ *  the board, so the memory it touches first, which the system puts next to
+ *  the processor it was on, stays next to it from then on.
+ */
+
+/* Picking the processors a thread runs on is left out by -ansi unless we
+   ask for it. */
+#define _GNU_SOURCE
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+
+#ifdef HAVE_UNISTD_H
+    #include <unistd.h>
+#endif
+
+#ifdef HAVE_PTHREAD_H
+    #include <pthread.h>
+#endif
+
+#ifdef HAVE_SCHED_H
+    #include <sched.h>
+#endif
+
+#include "game.h"
+#include "threads.h"
+
+
+static int nthreads = 1;            /*< Number of threads, including us. */
+static int binding = 0;             /*< Are threads kept on processors? */
+static void (*cur_job)( int, int, void * ); /*< The job being run. */
+static void *cur_arg;               /*< Its argument. */
+
+#ifdef HAVE_PTHREAD_H
+static pthread_t workers[THREADS_MAX];  /*< The worker threads. */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;  /*< New job. */
+static pthread_cond_t done = PTHREAD_COND_INITIALIZER;  /*< Job finished. */
+static pthread_cond_t meet = PTHREAD_COND_INITIALIZER;  /*< Barrier. */
+static int job_no;                  /*< Incremented for every new job. */
+static int busy;                    /*< Workers still running the job. */
+static int waiting;                 /*< Threads waiting at the barrier. */
+static int phase;                   /*< Incremented when the barrier opens. */
+static int quitting;                /*< Set when the workers should exit. */
+static pthread_t runner;            /*< The thread running a job in the
+                                        background... */
+static int running;                 /*< ...if there is one... */
+static void (*bg_job)( int, int, void * );  /*< ...the job... */
+static void *bg_arg;                /*< ...and its argument. */
+
+#if defined(CPU_SET) && defined(CPU_COUNT)
+    #define THREADS_PIN
+static cpu_set_t allowed;           /*< The processors we may run on... */
+static int pinned;                  /*< ...and whether the main thread has
+                                        been kept to one of them. */
+#endif
+
+
+/* Keep the calling thread, worker id, on a processor of its own, or on the
+   same one as every so many workers if there are more of them than
+   processors. */
+static void threads_pin( int id )
+{
+    #ifdef THREADS_PIN
+        cpu_set_t one;              /*< The processor it gets. */
+        int i, k;                   /*< Iterator and the one we want. */
+
+        if ( CPU_COUNT( &allowed ) == 0 )
+            return;
+
+        k = id % CPU_COUNT( &allowed );
+        for ( i = 0; !CPU_ISSET( i, &allowed ) || k-- > 0; i++ ){};
+        CPU_ZERO( &one );
+        CPU_SET( i, &one );
+        sched_setaffinity( 0, sizeof(one), &one );
+    #else
+        (void) id;
+    #endif
+}
+
+
+/* The life of a worker thread. Wait for a job, run it, repeat. */
+static void *threads_main( void *arg )
+{
+    int id = (int) (size_t) arg;    /*< Our worker number. */
+    int seen = 0;                   /*< The last job we ran. */
+
+    threads_pin( id );
+    pthread_mutex_lock( &lock );
+    while ( 1 )
+    {
+        while ( job_no == seen && !quitting )
+            pthread_cond_wait( &wake, &lock );
+        if ( quitting )
+            break;
+        seen = job_no;
+        pthread_mutex_unlock( &lock );
+
+        cur_job( id, nthreads, cur_arg );
+
+        pthread_mutex_lock( &lock );
+        busy--;
+        if ( busy == 0 )
+            pthread_cond_signal( &done );
+    }
+    pthread_mutex_unlock( &lock );
+
+    return NULL;
+}
+
+
+/* The life of the background thread. It runs the job as worker 0. */
+static void *threads_behind( void *arg )
+{
+    (void) arg;
+    threads_pin( 0 );
+    threads_run( bg_job, bg_arg );
+
+    return NULL;
+}
+#endif
+
+
+/* Start a pool of n threads. If n is 0, we use one thread per processor.
+   Returns the number of threads we actually got. */
+int threads_start( int n )
+{
+    threads_end();
+
+    #if defined(HAVE_UNISTD_H) && defined(_SC_NPROCESSORS_ONLN)
+        if ( n <= 0 )
+            n = (int) sysconf( _SC_NPROCESSORS_ONLN );
+    #endif
+    n = MAX( 1, MIN( n, THREADS_MAX ) );
+
+    #ifdef HAVE_PTHREAD_H
+        #ifdef THREADS_PIN
+            CPU_ZERO( &allowed );
+            if ( n > 1 && binding &&
+                 sched_getaffinity( 0, sizeof(allowed), &allowed ) == 0 )
+            {
+                threads_pin( 0 );
+                pinned = 1;
+            }
+        #endif
+
+        quitting = 0;
+        job_no = 0;
+        for ( nthreads = 1; nthreads < n; nthreads++ )
+        {
+            if ( pthread_create( workers + nthreads, NULL, threads_main,
+                                 (void *) (size_t) nthreads ) != 0 )
+                break;
+        }
+    #else
+        nthreads = 1;
+    #endif
+
+    return nthreads;
+}
+
+
+/* Have the pools started from now on keep their threads on processors of
+   their own, or not. Other programs get the processors the game isn't
+   using, so it is left to the player to ask. */
+void threads_bind( int on )
+{
+    binding = on;
+}
+
+
+/* Stop all of the worker threads. */
+void threads_end( void )
+{
+    #ifdef HAVE_PTHREAD_H
+        int i;                      /*< Iterator. */
+
+        threads_finish();
+        pthread_mutex_lock( &lock );
+        quitting = 1;
+        pthread_cond_broadcast( &wake );
+        pthread_mutex_unlock( &lock );
+
+        for ( i = 1; i < nthreads; i++ )
+            pthread_join( workers[i], NULL );
+
+        /* The main thread can go back to running anywhere. */
+        #ifdef THREADS_PIN
+            if ( pinned )
+                sched_setaffinity( 0, sizeof(allowed), &allowed );
+            pinned = 0;
+        #endif
+    #endif
+
+    nthreads = 1;
+}
+
+
+/* The number of threads in the pool. */
+int threads_count( void )
+{
+    return nthreads;
+}
+
+
+/* Run a job on every thread and wait for all of them to finish. The job is
+   given its worker number and the number of workers. */
+void threads_run( void (*job)( int id, int n, void *arg ), void *arg )
+{
+    cur_job = job;
+    cur_arg = arg;
+
+    if ( nthreads == 1 )
+    {
+        job( 0, 1, arg );
+        return;
+    }
+
+    #ifdef HAVE_PTHREAD_H
+        pthread_mutex_lock( &lock );
+        busy = nthreads-1;
+        job_no++;
+        pthread_cond_broadcast( &wake );
+        pthread_mutex_unlock( &lock );
+
+        job( 0, nthreads, arg );
+
+        pthread_mutex_lock( &lock );
+        while ( busy > 0 )
+            pthread_cond_wait( &done, &lock );
+        pthread_mutex_unlock( &lock );
+    #endif
+}
+
+
+/* Wait until every thread running the current job gets here. Every thread
+   has to call this the same number of times, even if it had no work. */
+void threads_wait( void )
+{
+    #ifdef HAVE_PTHREAD_H
+        int mine;                   /*< The phase we are waiting out. */
+
+        if ( nthreads == 1 )
+            return;
+
+        pthread_mutex_lock( &lock );
+        mine = phase;
+        waiting++;
+        if ( waiting == nthreads )
+        {
+            waiting = 0;
+            phase++;
+            pthread_cond_broadcast( &meet );
+        }
+        else
+        {
+            while ( phase == mine )
+                pthread_cond_wait( &meet, &lock );
+        }
+        pthread_mutex_unlock( &lock );
+    #endif
+}
+
+
+/* Find the band of rows [y0,y1) that worker id of n handles on a board with
+   h rows. Bands may be empty when there are more workers than rows. */
+void threads_band( int id, int n, int h, int *y0, int *y1 )
+{
+    *y0 = (int) ( (double) h * id / n );
+    *y1 = (int) ( (double) h * (id+1) / n );
+}
+
+
+/* Start a job on every thread like threads_run(), but return right away so
+   the main thread can get on with something else. It has to be finished
+   with threads_finish() before anything else is run. */
+void threads_begin( void (*job)( int id, int n, void *arg ), void *arg )
+{
+    threads_finish();
+
+    #ifdef HAVE_PTHREAD_H
+        bg_job = job;
+        bg_arg = arg;
+        if ( pthread_create( &runner, NULL, threads_behind, NULL ) == 0 )
+        {
+            running = 1;
+            return;
+        }
+    #endif
+
+    threads_run( job, arg );
+}
+
+
+/* Wait for the job in the background to finish, if there is one. */
+void threads_finish( void )
+{
+    #ifdef HAVE_PTHREAD_H
+        if ( running )
+        {
+            pthread_join( runner, NULL );
+            running = 0;
+        }
+    #endif
+}
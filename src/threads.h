@@ -0,0 +1,44 @@
+/*
+ *  HackOfLife - threads.h
+ *  Copyright (c) 2009  Barry "Ishara" Peddycord - http://isharacomix.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __THREADS_H
+#define __THREADS_H
+
+
+/* The most threads we will ever run, including the main thread. */
+#define THREADS_MAX 64
+
+
+/* Starting and stopping the workers. */
+int threads_start( int n );
+void threads_end( void );
+int threads_count( void );
+void threads_bind( int on );
+
+/* Running jobs on every thread. */
+void threads_run( void (*job)( int id, int n, void *arg ), void *arg );
+void threads_wait( void );
+void threads_band( int id, int n, int h, int *y0, int *y1 );
+
+/* Running a job in the background. */
+void threads_begin( void (*job)( int id, int n, void *arg ), void *arg );
+void threads_finish( void );
+
+
+#endif /* __THREADS_H */
+
@@ -0,0 +1,178 @@
+/*
+ *  HackOfLife - tiles.c
+ *  Copyright (c) 2009  Barry "Ishara" Peddycord - http://isharacomix.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Most of a board is empty or sitting still, so the deterministic engines
+ *  only look at the parts that are moving. The board is split into tiles,
+ *  and every tile remembers whether anything in it changed. A tile can only
+ *  change if it or one of its eight neighbors changed last generation (or
+ *  was touched by a player since), so every other tile is skipped.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <limits.h>
+
+#include "game.h"
+#include "bitboard.h"
+#include "tiles.h"
+
+
+static char *dirty = NULL;      /*< Tiles changed since this generation. */
+static char *touched = NULL;    /*< Tiles changed since the last one. */
+static char *active = NULL;     /*< Tiles next to a touched tile. */
+static char *needed = NULL;     /*< Tiles next to an active tile. */
+static int tw, th;              /*< Tiles per row and rows of tiles. */
+static int twrap;               /*< Does the board wrap? */
+
+
+/* Set up the tiles of a w by h board, all of them marked as changed.
+   Returns 0 if we ran out of memory. */
+int tiles_reset( int w, int h, int wrap )
+{
+    tiles_free();
+    tw = ( w + TILE_W - 1 ) / TILE_W;
+    th = ( h + TILE_H - 1 ) / TILE_H;
+    twrap = wrap;
+
+    dirty = malloc( sizeof(char)*tw*th*4 );
+    if ( dirty == NULL )
+        return 0;
+    touched = dirty + tw*th;
+    active = dirty + tw*th*2;
+    needed = dirty + tw*th*3;
+
+    tiles_mark_all();
+    return 1;
+}
+
+
+/* Release the tiles. */
+void tiles_free( void )
+{
+    if ( dirty != NULL ) free( dirty );
+
+    dirty = NULL;
+    touched = NULL;
+    active = NULL;
+    needed = NULL;
+    tw = 0;
+    th = 0;
+}
+
+
+/* The number of rows of tiles. */
+int tiles_rows( void )
+{
+    return th;
+}
+
+
+/* Mark the tile holding cell x,y as changed. Anything that edits the life
+   grid outside of next_generation() has to call this. */
+void tiles_mark( int x, int y )
+{
+    if ( dirty != NULL )
+        dirty[ (y/TILE_H)*tw + x/TILE_W ] = 1;
+}
+
+
+/* Mark every tile as changed. */
+void tiles_mark_all( void )
+{
+    if ( dirty != NULL )
+        memset( dirty, 1, sizeof(char)*tw*th );
+}
+
+
+/* Mark a tile as changed by the current generation. Only the thread working
+   on the tile's row may call this. */
+void tiles_changed( int tx, int ty )
+{
+    dirty[ ty*tw + tx ] = 1;
+}
+
+
+/* Mark every tile next to (or on) a marked tile in src. */
+static void tiles_grow( const char *src, char *dst )
+{
+    int x, y, i, j, u, v;       /*< Iterators. */
+
+    memset( dst, 0, sizeof(char)*tw*th );
+    for ( y = 0; y < th; y++ )
+    {
+        for ( x = 0; x < tw; x++ )
+        {
+            if ( !src[ y*tw + x ] )
+                continue;
+
+            for ( j = -1; j <= 1; j++ )
+            {
+                for ( i = -1; i <= 1; i++ )
+                {
+                    u = x+i;
+                    v = y+j;
+                    if ( twrap )
+                    {
+                        u = ( u + tw ) % tw;
+                        v = ( v + th ) % th;
+                    }
+                    else if ( u < 0 || u >= tw || v < 0 || v >= th )
+                        continue;
+
+                    dst[ v*tw + u ] = 1;
+                }
+            }
+        }
+    }
+}
+
+
+/* Start a new generation. The tiles that changed since the last one become
+   the touched tiles, and the tiles around them become active. A tile is
+   needed if an active tile might read its cells. */
+void tiles_begin( void )
+{
+    memcpy( touched, dirty, sizeof(char)*tw*th );
+    memset( dirty, 0, sizeof(char)*tw*th );
+    tiles_grow( touched, active );
+    tiles_grow( active, needed );
+}
+
+
+/* Has anything in the tile changed since the last generation began? */
+int tiles_touched( int tx, int ty )
+{
+    return touched[ ty*tw + tx ];
+}
+
+
+/* Might anything in the tile change this generation? */
+int tiles_active( int tx, int ty )
+{
+    return active[ ty*tw + tx ];
+}
+
+
+/* Will an active tile read any of the tile's cells this generation? */
+int tiles_needed( int tx, int ty )
+{
+    return needed[ ty*tw + tx ];
+}
@@ -0,0 +1,46 @@
+/*
+ *  HackOfLife - tiles.h
+ *  Copyright (c) 2009  Barry "Ishara" Peddycord - http://isharacomix.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TILES_H
+#define __TILES_H
+
+
+/* The size of a tile in cells. A tile is one packed word wide. */
+#define TILE_W      BB_BITS
+#define TILE_H      32
+
+
+/* Setting up the tiles of a board. */
+int tiles_reset( int w, int h, int wrap );
+void tiles_free( void );
+int tiles_rows( void );
+
+/* Marking the tiles that changed. */
+void tiles_mark( int x, int y );
+void tiles_mark_all( void );
+void tiles_changed( int tx, int ty );
+
+/* Finding the tiles that need work this generation. */
+void tiles_begin( void );
+int tiles_touched( int tx, int ty );
+int tiles_active( int tx, int ty );
+int tiles_needed( int tx, int ty );
+
+
+#endif /* __TILES_H */
+
@@ -18,12 +18,11 @@
  *  The super-massive game handler. Everything that happens within the game
  *  world happens here, and I do mean everything!
  *
- *  The cells of the grid of life are defined as 2-digit decimal numbers.
- *      00      Cell is dead (there are no colorless seeds)
- *      0x      Cell is a seed of color 'x'
- *      1x      Cell is alive and is color 'x'
- *  The player is always color '1'. A cell is alive if its value > 9.
- *  Colorless cells are number 10.
+ *  The cells of the grid of life are four bits, an alive bit and a color.
+ *      0000    Cell is dead (there are no colorless seeds)
+ *      0xxx    Cell is a seed of color 'x'
+ *      1xxx    Cell is alive and is color 'x'
+ *  The player is always color '1'. Colorless live cells are CELL_LIVE.
  */
 
 #include <config.h>
@@ -37,27 +36,199 @@
 #include <time.h>
 #include <curses.h>
 
+#ifdef TIME_WITH_SYS_TIME
+    #include <sys/time.h>
+#endif
+
 #include "game.h"
 #include "graphics.h"
 #include "random.h"
 #include "world.h"
 #include "network.h"
+#include "bitboard.h"
+#include "bitslice.h"
+#include "threads.h"
+#include "tiles.h"
+#include "hashlife.h"
+#include "sparse.h"
+#include "grids.h"
 
 
 static int loptions[OP_N];      /*< Our list of game options. */
 static char *lgrid;             /*< The life grid. Contains the cells. */
-static char *wgrid;             /*< The working grid. Used for counting
-                                        neighbors. */
+static char *wgrid;             /*< The working grid. The next generation
+                                        is written here, and then the grids
+                                        are swapped. */
+static unsigned long *csums = NULL; /*< Column sums of every thread. */
+static char *unpacked = NULL;   /*< Rows of every thread, for grids kept two
+                                        cells to a byte. */
+static long deltas[THREADS_MAX][10];    /*< Score changes of every thread. */
+static int last_engine;         /*< The bit-parallel engine that ran last
+                                        generation, or 0. */
+static char chances[CELL_STATES][9];    /*< The rule table. The chance out
+                                        of 100 that a cell survives or is
+                                        born, by cell and number of
+                                        neighbors... */
+static char passes[CELL_STATES][8];     /*< ...the next state if it does, by
+                                        cell and majority color... */
+static char fails[CELL_STATES]; /*< ...and the next state if it doesn't. */
+static int rule_opts[18];       /*< The rulestrings the table was made of. */
+static int rule_hatch = -1;     /*< The hatch mask the table was made with. */
+
+/* One 4-bit counter for each color of live cell, so the neighbors of a cell
+   can be added up in a single word. */
+static const unsigned long counter[CELL_STATES] =
+    { 0, 0, 0, 0, 0, 0, 0, 0,
+      1UL, 1UL<<4, 1UL<<8, 1UL<<12, 1UL<<16, 1UL<<20, 1UL<<24, 0 };
+static unsigned char majors[2][4096];   /*< The largest counter of colors 1-3
+                                        and 4-6 times 16, plus its color
+                                        (or 0 for a tie). */
 static int gw, gh;              /*< The dimensions of the life grid. */
+static int sw, sh;              /*< The part of it filled at the start. */
+static int sparse;              /*< Is the board kept by the sparse engine
+                                        instead of in the grids? */
+static int packed;              /*< Are the grids kept two cells to a byte
+                                        instead of one? */
+static int np;                  /*< The bytes in a row of them. */
+static int tiled;               /*< Are the grids kept in pages of 64x64
+                                        cells instead of rows? */
+static int pw;                  /*< The pages across them. */
+
+/* The front of a board file, which says which grid holds the last board
+   written out to the disk and how far along it is. The game keeps its own
+   count of where the board is, and only changes the front once the grids
+   are on the disk. The grid it names isn't written again until the front
+   names another one, so the next generations go into the other two, and
+   the file holds a whole generation even if the system goes down. */
+struct board_head
+{
+    char magic[8];              /*< BOARD_MAGIC. */
+    int w, h;                   /*< The size of the board. */
+    int gen;                    /*< The generation it is at... */
+    int grid;                   /*< ...which of the grids holds it, or -1
+                                        if none does yet... */
+    unsigned long seed;         /*< ...and where its random numbers start. */
+};
+#define BOARD_MAGIC "HOLROWS1"  /*< What every board file starts with. */
+#define BOARD_GRIDS 3           /*< The grids in a board file: the one its
+                                        front names, and two to work in. */
+static const char *board_name = NULL;   /*< The board file, if the board is
+                                        kept in one... */
+static int mapped;              /*< ...whether this board is... */
+static struct board_head *head; /*< ...the front of it... */
+static char *grids[BOARD_GRIDS];    /*< ...its grids... */
+static int can_resume;          /*< ...whether the first board of the run can
+                                        pick up where the file left off... */
+static int resume;              /*< ...and whether this one does. */
+
+/* A way of moving the board along a generation, and of keeping it. */
+struct engine
+{
+    const char *name;           /*< What -engine= and the rules call it. */
+    int (*fits)( void );        /*< Can it run this board and rules? */
+    int (*init)( void );        /*< Reserve an empty board. Returns 0 if we
+                                        ran out of memory. */
+    void (*step)( void );       /*< Work out the next generation. */
+    int (*get)( int x, int y ); /*< The cell at x,y... */
+    int (*set)( int x, int y, int v );  /*< ...and changing it. Returns 0
+                                        if there was no room for it. */
+    void (*ahead)( int id, int n, void *arg );  /*< The job that works out
+                                        the next generation into wgrid
+                                        without changing lgrid, so it can
+                                        be run while the players are busy,
+                                        or NULL. */
+    int band;                   /*< The rows it hands the threads at a
+                                        time, or 0 if it doesn't split the
+                                        grids between them. */
+};
+static const struct engine *eng;    /*< The engine of this board... */
+static const char *wanted = NULL;   /*< ...and the one asked for. */
+static const struct engine *dense_eng;  /*< The engine a board that went
+                                        sparse comes back to, or NULL if
+                                        the board stays where it is. */
 static int cam_x, cam_y;        /*< The camera position (the top left cell
                                         on in the viewport). */
-#define el(x,y) ( (y)*gw + (x) )    /*< This gets the element provided. */
+#define el(x,y) ( (size_t) ((y)+1)*(gw+2) + (x)+1 )  /*< This gets the
+                                        element provided. The grids have a
+                                        border one cell wide around them, and
+                                        are counted in size_t, since a big
+                                        board has more cells than an int. */
+#define gsz ( (size_t) (gw+2)*(gh+2) ) /*< The size of a grid with its
+                                        border. */
+#define nib(x,y) ( (size_t) (y)*np + ((x)>>1) )    /*< The byte holding the
+                                        element when the grid is kept two
+                                        cells to a byte, with no border... */
+#define nsh(x) ( ((x)&1) << 2 )        /*< ...how far up it sits... */
+#define nsz ( (size_t) np*gh )         /*< ...and the size of the grid. */
+#define pg(x,y) ( ( ( (size_t) ((y)>>6)*pw + ((x)>>6) ) << 12 ) + \
+                  ( ((y)&63) << 6 ) + ( (x)&63 ) )  /*< The element when
+                                        the grids are kept in pages of 64x64
+                                        cells, each one 4 KB with a cache
+                                        line for every row, and no
+                                        border... */
+#define psz ( (size_t) pw * ( (gh+63) >> 6 ) << 12 )   /*< ...and the size
+                                        of the grid. */
+#define at(x,y) ( ( tiled ) ? pg(x,y) : el(x,y) )  /*< The element in grids
+                                        kept in rows or in pages. */
+#define gbytes ( ( packed ) ? nsz : ( tiled ) ? psz : gsz )   /*< The size
+                                        of the grids, however they are
+                                        kept. */
+#define FILL_N 256              /*< Dice rolled at a time when filling the
+                                        board. */
+#define FILL_CHANCE 858993460UL /*< rnd_32int() is below this 20% of the
+                                        time. */
+#define FAST_FORWARD 1024       /*< Generations skipped by fast-forward. */
+#define CYCLE_N 64              /*< The longest cycle of boards noticed. */
+#define SPEC_N 16               /*< The most cells the players can change
+                                        under a generation worked out ahead
+                                        of time. */
+#define DENSE_MAX 1048576       /*< Boards bigger than this a side are
+                                        sparse, so a row and the distance to
+                                        a neighbor always fit in an int. */
+#define CHECKPOINT_N 64         /*< How many generations a board file goes
+                                        between being written out. */
+#define SPARSE_SPAN 1024        /*< How much of a sparse board is filled at
+                                        the start, a side. */
+#define ADAPT_MIN 65536         /*< Boards with fewer cells than this stay in
+                                        the grids however empty they get. */
+#define BLOCK_K 8               /*< The most generations a block of the board
+                                        is moved along at once. */
+#define BLOCK_SZ 128            /*< The size of a block, a side... */
+#define BLOCK_P ( BLOCK_SZ + 2*BLOCK_K )    /*< ...and with the cells around
+                                        it. */
 
 static int gen_no;              /*< The current generation. */
-static int scores[10];          /*< The score counts. */
+static unsigned long game_seed; /*< Where the random numbers of every
+                                        generation come from. */
+static long scores[10];         /*< The score counts. */
 static int seeds[10];           /*< The seed counts. */
 static int colors[10];          /*< The colors of the various players. */
 static int players[10][3];      /*< Player status and locations. */
+static unsigned long history[CYCLE_N];  /*< Hashes of the last boards... */
+static int hist_n;              /*< ...and how many there are. */
+static int cycle;               /*< The number of generations the board takes
+                                        to repeat itself, or 0 if it
+                                        hasn't. */
+struct kept_cell
+{
+    unsigned long x, y;         /*< Where the cell is... */
+    int v;                      /*< ...and what it was. */
+};
+static int kept_p;              /*< The cycle the board seems to be in, or 0
+                                        if none, waiting for a copy of the
+                                        board... */
+static int kept_gen;            /*< ...kept at this generation... */
+static char *kept;              /*< ...of the grids... */
+static struct kept_cell *kept_cells;    /*< ...or of the cells of a sparse
+                                        board... */
+static unsigned long kept_n, kept_room; /*< ...how many of them there are,
+                                        and room for. */
+static int spec;                /*< Is the next generation being worked out
+                                        ahead of time?... */
+static long spec_scores[10];    /*< ...the scores it started from... */
+static int spec_x[SPEC_N], spec_y[SPEC_N];  /*< ...the cells changed
+                                        since... */
+static int spec_n;              /*< ...and how many. */
 
 static int game_mode;           /*< This is our game mode. */
 static int stasis;              /*< Are we in stasis mode? SANDBOX ONLY */
@@ -72,6 +243,461 @@ static int top_msg;             /*< The front of the circular buffer. */
 static FILE *logfile = NULL;    /*< Message logger. */
 
 
+/* Put the other processors to work, and reserve the memory the regular
+   engine needs for them. */
+static void start_workers( void )
+{
+    threads_start( loptions[OP_THREADS] );
+    
+    /* Without the column sums, we just count neighbors the old way. Sparse
+       boards don't count them in rows at all. */
+    if ( csums != NULL ) free( csums );
+    csums = NULL;
+    if ( !sparse )
+        csums = calloc( sizeof(unsigned long), (gw+3)*threads_count() );
+}
+
+
+/* Where row y of the grids starts, however they are kept, with row gh at
+   the end of them. */
+static size_t row_at( int y )
+{
+    if ( y >= gh )
+        return gbytes;
+    if ( packed )
+        return nib(0,y);
+    if ( tiled )
+        return pg(0,y);
+    return el(-1,y);
+}
+
+
+/* Touch the pages of the grids in the band of rows this thread steps, and
+   empty them first if arg says so. The system puts every page on the
+   memory node of the processor that touches it first, so each band ends
+   up next to the thread that works on it. */
+static void spread_job( int id, int n, void *arg )
+{
+    int y0, y1;             /*< The band, in rows. */
+    size_t a, b, i;         /*< The bytes of the grids in it. */
+    
+    threads_band( id, n, ( gh + eng->band - 1 ) / eng->band, &y0, &y1 );
+    a = ( y0 == 0 ) ? 0 : row_at( y0*eng->band );
+    b = row_at( y1*eng->band );
+    if ( a >= b )
+        return;
+    
+    grid_place( lgrid, a, b );
+    grid_place( wgrid, a, b );
+    if ( arg != NULL )
+    {
+        grid_clear( lgrid, a, b );
+        grid_clear( wgrid, a, b );
+    }
+    for ( i = a; i < b; i += 4096 )
+    {
+        lgrid[i] = 0;
+        wgrid[i] = 0;
+    }
+    lgrid[b-1] = 0;
+    wgrid[b-1] = 0;
+}
+
+
+/* Spread the grids between the threads that step them, emptying them on
+   the way if empty. A single thread empties them itself, and leaves them
+   to be filled in as they are touched. */
+static void spread_grids( int empty )
+{
+    threads_finish();
+    if ( threads_count() > 1 && !sparse && eng->band > 0 )
+        threads_run( spread_job, empty ? &empty : NULL );
+    else if ( empty )
+    {
+        grid_clear( lgrid, 0, gbytes );
+        grid_clear( wgrid, 0, gbytes );
+    }
+}
+
+
+/* Free the memory associated with the game board. */
+static void free_board( void )
+{
+    int i;                  /*< Iterator. */
+    
+    threads_finish();
+    spec = 0;
+    for ( i = 0; mapped && i < BOARD_GRIDS; i++ )
+        grid_free( grids[i] );
+    if ( !mapped )
+    {
+        grid_free( lgrid );
+        grid_free( wgrid );
+    }
+    if ( csums != NULL ) free( csums );
+    if ( unpacked != NULL ) free( unpacked );
+    csums = NULL;
+    unpacked = NULL;
+    threads_end();
+    tiles_free();
+    bb_free();
+    bs_free();
+    hl_free();
+    sp_free();
+    grid_free( kept );
+    if ( kept_cells != NULL ) free( kept_cells );
+    kept = NULL;
+    kept_cells = NULL;
+    kept_room = 0;
+    kept_p = 0;
+    sparse = 0;
+    packed = 0;
+    tiled = 0;
+    mapped = 0;
+    dense_eng = NULL;
+    lgrid = NULL;
+    wgrid = NULL;
+}
+
+
+/* Reserve the grids for an empty gw by gh board. Returns 0 if we ran out of
+   memory. */
+static int dense_init( void )
+{
+    sparse = 0;
+    packed = 0;
+    tiled = 0;
+    mapped = 0;
+    sw = gw;
+    sh = gh;
+    
+    lgrid = grid_alloc( gbytes );
+    wgrid = grid_alloc( gbytes );
+    if ( lgrid == NULL || wgrid == NULL ||
+         !tiles_reset( gw, gh, loptions[OP_GRID_WRAP] ) )
+    {
+        /* Redundant error checking is redundant. */
+        grid_free( lgrid );
+        grid_free( wgrid );
+        
+        return 0;
+    }
+    return 1;
+}
+
+
+/* Reserve the grids for an empty gw by gh board kept two cells to a byte,
+   in half the memory, and the rows each thread unpacks them into. Returns 0
+   if we ran out of memory. */
+static int packed_init( void )
+{
+    sparse = 0;
+    packed = 1;
+    tiled = 0;
+    mapped = 0;
+    sw = gw;
+    sh = gh;
+    np = ( gw + 1 ) / 2;
+    
+    lgrid = grid_alloc( nsz );
+    wgrid = grid_alloc( nsz );
+    unpacked = calloc( sizeof(char), 3*(gw+2)*THREADS_MAX );
+    if ( lgrid == NULL || wgrid == NULL || unpacked == NULL )
+    {
+        grid_free( lgrid );
+        grid_free( wgrid );
+        if ( unpacked != NULL ) free( unpacked );
+        unpacked = NULL;
+        
+        return 0;
+    }
+    return 1;
+}
+
+
+/* Reserve the grids for an empty gw by gh board kept in pages of 64x64
+   cells, so the rows around a cell are close together. Returns 0 if we ran
+   out of memory. */
+static int tiled_init( void )
+{
+    sparse = 0;
+    packed = 0;
+    tiled = 1;
+    mapped = 0;
+    sw = gw;
+    sh = gh;
+    pw = ( gw + 63 ) >> 6;
+    
+    lgrid = grid_alloc( psz );
+    wgrid = grid_alloc( psz );
+    if ( lgrid == NULL || wgrid == NULL )
+    {
+        grid_free( lgrid );
+        grid_free( wgrid );
+        
+        return 0;
+    }
+    return 1;
+}
+
+
+/* Map the grids of a gw by gh board from the board file, so the board can
+   be bigger than memory. If the file already holds a board this size, the
+   first board of the run picks up where it left off. Files that hold
+   something else are left alone. Returns 0 if the file can't be used. */
+static int mapped_init( void )
+{
+    struct board_head old;      /*< What the file holds now. */
+    FILE *f;                    /*< The file, to look at it. */
+    size_t n = 0;               /*< How much of its front there is. */
+    int i;                      /*< Iterator. */
+    
+    sparse = 0;
+    packed = 0;
+    tiled = 0;
+    sw = gw;
+    sh = gh;
+    
+    f = fopen( board_name, "rb" );
+    if ( f != NULL )
+    {
+        n = fread( &old, 1, sizeof old, f );
+        fclose( f );
+    }
+    resume = ( can_resume && n == sizeof old &&
+               memcmp( old.magic, BOARD_MAGIC, 8 ) == 0 &&
+               old.w == gw && old.h == gh &&
+               old.grid >= 0 && old.grid < BOARD_GRIDS );
+    can_resume = 0;
+    
+    head = NULL;
+    if ( n == 0 || ( n == sizeof old &&
+                     memcmp( old.magic, BOARD_MAGIC, 8 ) == 0 ) )
+        head = grid_map( board_name, sizeof(struct board_head), gsz,
+                         BOARD_GRIDS, !resume, grids );
+    if ( head == NULL || !tiles_reset( gw, gh, loptions[OP_GRID_WRAP] ) )
+    {
+        for ( i = 0; head != NULL && i < BOARD_GRIDS; i++ )
+            grid_free( grids[i] );
+        lgrid = NULL;
+        wgrid = NULL;
+        resume = 0;
+        
+        sprintf( wbuffer, "The board file %.50s can't be used.", board_name );
+        pmsg( wbuffer );
+        return 0;
+    }
+    
+    if ( !resume )
+    {
+        memcpy( head->magic, BOARD_MAGIC, 8 );
+        head->w = gw;
+        head->h = gh;
+        head->gen = 0;
+        head->grid = -1;
+        head->seed = 0;
+    }
+    mapped = 1;
+    lgrid = grids[0];
+    wgrid = grids[1];
+    
+    /* The players can change the board before it moves on, so a board that
+       is picked up is copied out of the grid the front names first. */
+    if ( resume )
+    {
+        lgrid = grids[ ( head->grid + 1 ) % BOARD_GRIDS ];
+        wgrid = grids[ ( head->grid + 2 ) % BOARD_GRIDS ];
+        memcpy( lgrid, grids[ head->grid ], gsz );
+    }
+    return 1;
+}
+
+
+/* Which of the grids of the board file grid p is. */
+static int board_grid( const char *p )
+{
+    int i;                 /*< Iterator. */
+    
+    for ( i = 0; i < BOARD_GRIDS - 1 && grids[i] != p; i++ ){};
+    return i;
+}
+
+
+/* Make sure the next generation doesn't go into the grid the front of the
+   board file names. After the grids are flipped, it goes into the one left
+   over instead. */
+static void spare_grid( void )
+{
+    /* The grids are numbered 0 to 2, so this is the one left over. */
+    if ( head->grid >= 0 && wgrid == grids[ head->grid ] )
+        wgrid = grids[ 3 - head->grid - board_grid( lgrid ) ];
+}
+
+
+/* Write the board out to its file as generation gen, just before it moves
+   on, when nothing changes lgrid any more. Waiting on the disk every
+   generation would slow the game down, so it is only written out every
+   CHECKPOINT_N generations, or now if now is set. The grids go first, and
+   only once they are on the disk does the front of the file follow and name
+   the one that holds the board. Until the front names another one, that
+   grid is only ever read. */
+static void checkpoint( int gen, int now )
+{
+    static int written = 0;    /*< The generation last written out. */
+    
+    if ( now || gen <= written || gen - written >= CHECKPOINT_N )
+    {
+        grid_sync( 0 );
+        head->gen = gen;
+        head->grid = board_grid( lgrid );
+        head->seed = game_seed;
+        grid_sync( 1 );
+        written = gen;
+    }
+    spare_grid();
+}
+
+
+/* Stop the front of the board file from naming a grid, before the grids
+   are emptied for a new board. */
+static void forget_board( void )
+{
+    head->grid = -1;
+    grid_sync( 1 );
+}
+
+
+/* Set up an empty gw by gh board that only keeps the cells that aren't
+   empty. Filling all of it would leave nothing sparse about it, so only
+   one corner is filled at the start. Returns 0 if we ran out of memory. */
+static int sparse_init( void )
+{
+    sparse = 1;
+    packed = 0;
+    tiled = 0;
+    mapped = 0;
+    sw = MIN( gw, SPARSE_SPAN );
+    sh = MIN( gh, SPARSE_SPAN );
+    
+    lgrid = NULL;
+    wgrid = NULL;
+    return sp_reset( gw, gh, loptions[OP_GRID_WRAP] );
+}
+
+
+/* The cell at x,y in the grids... */
+static int dense_get( int x, int y )
+{
+    return lgrid[ el(x,y) ];
+}
+
+
+/* ...and changing it to v. */
+static int dense_set( int x, int y, int v )
+{
+    lgrid[ el(x,y) ] = v;
+    tiles_mark( x, y );
+    return 1;
+}
+
+
+/* The cell at x,y in grids kept two cells to a byte... */
+static int packed_get( int x, int y )
+{
+    return ( (unsigned char) lgrid[ nib(x,y) ] >> nsh(x) ) & 15;
+}
+
+
+/* ...and changing it to v. */
+static int packed_set( int x, int y, int v )
+{
+    char *c = lgrid + nib(x,y);     /*< The byte it's in. */
+    
+    *c = (char) ( ( *c & ~( 15 << nsh(x) ) ) | ( v << nsh(x) ) );
+    return 1;
+}
+
+
+/* The cell at x,y in grids kept in pages... */
+static int tiled_get( int x, int y )
+{
+    return lgrid[ pg(x,y) ];
+}
+
+
+/* ...and changing it to v. */
+static int tiled_set( int x, int y, int v )
+{
+    lgrid[ pg(x,y) ] = v;
+    return 1;
+}
+
+
+/* The cell at x,y on a sparse board... */
+static int sparse_get( int x, int y )
+{
+    return sp_get( x, y );
+}
+
+
+/* ...and changing it to v. */
+static int sparse_set( int x, int y, int v )
+{
+    return sp_set( x, y, v );
+}
+
+
+/* Reserve the memory for an empty gw by gh board, kept however the engine
+   picked for it wants. Returns 0 if we ran out of memory, or no engine can
+   run it. */
+static int alloc_board( void )
+{
+    if ( !pick_engine() )
+        return 0;
+    while ( !eng->init() )
+    {
+        if ( !next_engine() )
+            return 0;
+    }
+    
+    /* Boards kept in grids go sparse when they empty out, unless the player
+       asked for the engine. */
+    dense_eng = ( wanted == NULL && !sparse ) ? eng : NULL;
+    return 1;
+}
+
+
+/* The cell at x,y, wherever the board is kept. */
+static int cell_at( int x, int y )
+{
+    return eng->get( x, y );
+}
+
+
+/* Change the cell at x,y to v. Returns 0 if there was no room for it. */
+static int set_cell( int x, int y, int v )
+{
+    /* The generation being worked out ahead counts its score changes from
+       the cells it reads, so it has to be done reading them first. */
+    if ( spec )
+        threads_finish();
+    if ( !eng->set( x, y, v ) )
+        return 0;
+    
+    /* The next generation has to be fixed up around the cell. */
+    if ( spec )
+    {
+        if ( spec_n < SPEC_N )
+        {
+            spec_x[ spec_n ] = x;
+            spec_y[ spec_n ] = y;
+        }
+        spec_n++;
+    }
+    return 1;
+}
+
+
 /* Start playing the game based on the current rules, specifying the number of
    other players (not P1). We continue playing until we quit or the game ends
    (losing conquest mode, finishing challenge mode, etc) */
@@ -107,28 +733,24 @@ void play_game( int type, int num_players )
     /* Reserve the memory needed to play the Game of Life. */
     gw = loptions[OP_GRID_WIDTH];
     gh = loptions[OP_GRID_HEIGHT];
-    lgrid = malloc( sizeof(char)*gw*gh );
-    wgrid = malloc( sizeof(char)*gw*gh );
     
     /* ABORT! CATASTROPHE! PANIC! IF WE KEEP TRYING TO RUN THE GAME HERE, THE
        WORLD WILL COME TO A CATACLYSMIC END! */
-    if ( lgrid == NULL || wgrid == NULL )
-    {
-        /* Redundant error checking is redundant. */
-        if ( lgrid != NULL ) free( lgrid );
-        if ( wgrid != NULL ) free( wgrid );
-        
+    if ( !alloc_board() )
         return;
-    }
+    
+    /* The workers are there before the board is filled, so they can take
+       their parts of it first. */
+    start_workers();
     
     /* Prepare the game. */
     start_game( num_players );
     
-    /* Scatter the generators randomly. */
+    /* Scatter the generators randomly, where the cells are. */
     for ( n = 0; n < num_players+1; n++ )
     {
-        players[n+1][1] = rnd_31int()%gw;
-        players[n+1][2] = rnd_31int()%gh;
+        players[n+1][1] = rnd_31int()%sw;
+        players[n+1][2] = rnd_31int()%sh;
     }
     
     /* In challenge mode, load the starting places from an input file. */
@@ -168,6 +790,11 @@ void play_game( int type, int num_players )
                         m++;
                 }
             }
+            
+            /* The host's random numbers come after the positions. Older
+               hosts don't send them, so fuzzy games will drift apart. */
+            if ( m )
+                sscanf( m, "%lu", &game_seed );
         }
     }    
     else if ( is_connected() == 2 )
@@ -187,6 +814,7 @@ void play_game( int type, int num_players )
                     n+=sprintf(wbuffer+n,"%d %d ",
                                players[j+2][1],players[j+2][2]);
             }
+            n+=sprintf(wbuffer+n, "%lu", game_seed );
             
             send_message( wbuffer, i );
         }
@@ -196,7 +824,9 @@ void play_game( int type, int num_players )
     draw_all( 1 );
     while ( game_mode )
     {
-        /* Draw the screen and handle player input. */
+        /* Draw the screen and handle player input, working out the next
+           generation in the meantime. */
+        speculate();
         handle_input();
         
         /* Iterate to the next generation. */
@@ -204,6 +834,7 @@ void play_game( int type, int num_players )
         {
             next_generation();
             gen_no++;
+            find_cycle();
         }
         
         /* When extermination mode is running, if you run out of seeds and
@@ -299,9 +930,11 @@ void play_game( int type, int num_players )
         logfile = NULL;
     }
     
-    /* Free the memory associated with the game board. */
-    free( lgrid );
-    free( wgrid );
+    /* Free the memory associated with the game board, once its file has
+       the last of it. */
+    if ( mapped )
+        checkpoint( gen_no, 1 );
+    free_board();
 }
 
 
@@ -309,13 +942,33 @@ void play_game( int type, int num_players )
 void start_game( int num_players )
 {
     int i, j, c;            /*< Iterators. */
+    int x, y;               /*< Cell iterators. */
+    unsigned long fill[FILL_N];     /*< Dice for filling the board... */
+    unsigned long pick[FILL_N];     /*< ...and for picking a player. */
     
     /* Reset global variables, such as score counters and the like. */
-    gen_no = 0;
-    memset( scores, 0, sizeof(int)*10 );
+    gen_no = ( resume ) ? head->gen : 0;
+    game_seed = ( resume ) ? head->seed : rnd_32int();
+    memset( scores, 0, sizeof(long)*10 );
     memset( players, 0, sizeof(int)*10*3 );
-    memset( lgrid, 0, sizeof(char)*gw*gh );
-    memset( wgrid, 0, sizeof(char)*gw*gh );
+    hist_n = 0;
+    cycle = 0;
+    if ( sparse && dense_eng != NULL )
+    {
+        /* The last game went sparse. This one starts in the grids again. */
+        sp_free();
+        sparse = 0;
+        eng = dense_eng;
+        last_engine = 0;
+    }
+    if ( sparse )
+        sp_reset( gw, gh, loptions[OP_GRID_WRAP] );
+    else if ( !resume )
+    {
+        if ( mapped )
+            forget_board();
+        spread_grids( 1 );
+    }
     stasis = 0;
     chatting = 0;
     viewing = 0;
@@ -345,32 +998,80 @@ void start_game( int num_players )
     for ( i = 0; i < 10; i++ )
         seeds[i] = loptions[OP_STARTING_SEEDS];
     
-    /* Populate the field with random items in conquest mode. */
-    if ( game_mode == G_CONQUEST && num_players > 0 )
+    /* A board picked up from its file is already filled, and only has to be
+       counted. */
+    if ( resume )
+    {
+        for ( y = 0; y < gh; y++ )
+        {
+            for ( x = 0; x < gw; x++ )
+            {
+                c = lgrid[ el(x,y) ];
+                if ( IS_ALIVE(c) )
+                    scores[ COLOR_OF(c) ] ++;
+            }
+        }
+        
+        sprintf( wbuffer, "Picked up the board at generation %d.", gen_no );
+        pmsg( wbuffer );
+    }
+    
+    /* Populate the field with random items in conquest mode. The dice are
+       rolled in blocks, every cell getting one whether it is used or not.
+       Filling all of a sparse board would leave nothing sparse about it, so
+       only one corner is filled. */
+    if ( game_mode == G_CONQUEST && num_players > 0 && !resume )
     {
-        for ( i = 0; i < gw*gh; i++ )
+        for ( y = 0; y < sh; y++ )
         {
-            if ( rnd_r2() < .20 )
+            for ( x = 0; x < sw; x++ )
             {
-                j = rnd_31int() % num_players;
-                lgrid[i] = 12+j;
-                scores[2+j] ++;
+                if ( x % FILL_N == 0 )
+                {
+                    rnd_block( fill, FILL_N );
+                    rnd_below( pick, FILL_N, num_players );
+                }
+                
+                if ( fill[ x % FILL_N ] < FILL_CHANCE )
+                {
+                    j = (int) pick[ x % FILL_N ];
+                    if ( set_cell( x, y, CELL_LIVE|(2+j) ) )
+                        scores[2+j] ++;
+                }
             }
         }
     }
     
     /* Populate the field with noise if the option is set. */
-    if ( game_mode != G_CHALLENGE && loptions[OP_NOISE] )
+    if ( game_mode != G_CHALLENGE && loptions[OP_NOISE] && !resume )
     {
-        for ( i = 0; i < gw*gh; i++ )
+        for ( y = 0; y < sh; y++ )
         {
-            if ( !lgrid[i] && rnd_r2() < .20 )
+            for ( x = 0; x < sw; x++ )
             {
-                lgrid[i] = 10;
-                scores[0] ++;
+                if ( x % FILL_N == 0 )
+                    rnd_block( fill, FILL_N );
+                
+                if ( !cell_at( x, y ) && fill[ x % FILL_N ] < FILL_CHANCE &&
+                     set_cell( x, y, CELL_LIVE ) )
+                    scores[0] ++;
             }
         }
     }
+    
+    /* Say so when only a corner of the board was filled, since a sparse
+       board plays out differently from a dense one started the same way. */
+    if ( ( sw < gw || sh < gh ) && !resume &&
+         ( game_mode == G_CONQUEST || loptions[OP_NOISE] ) )
+    {
+        sprintf( wbuffer, "Only the top left %d by %d cells of the sparse "
+                          "board were filled.", sw, sh );
+        pmsg( wbuffer );
+    }
+    
+    /* The whole board is new. */
+    tiles_mark_all();
+    resume = 0;
 }
 
 
@@ -410,6 +1111,8 @@ void handle_input( void )
     int acted;                  /*< This is true if we sent our act message
                                     to the other players. */
     int ready[10];              /*< Who are we waiting on in net play? */
+    int skip;                   /*< Does everyone want to skip ahead? 2
+                                    once it has been done. */
     char *m;                    /*< Network message string. */
     
     /* Set the players to zero and find the first one. */
@@ -508,7 +1211,8 @@ void handle_input( void )
             
             /* If an keypress is associated with an action that alters the
                board, then we defer acting on it until later. */
-            if ( (c == ' ' || c == ',' || c == 'Q' || c == 'e') && !ready[i] )
+            if ( (c == ' ' || c == ',' || c == 'Q' || c == 'e' || c == 'f')
+                 && !ready[i] )
                 ready[i] = c;
             
             /* Viewing mode... used for just looking around. */
@@ -574,6 +1278,10 @@ void handle_input( void )
                 n += sprintf( wbuffer+n, " wrapping." );
                 pmsg( wbuffer );
                 
+                /* The engine. */
+                sprintf( wbuffer, "The %s engine is running.", eng->name );
+                pmsg( wbuffer );
+                
                 /* Timeouts. */
                 if ( loptions[OP_TIMEOUT] )
                     sprintf( wbuffer, "Turns timeout after %d milliseconds.",
@@ -809,6 +1517,17 @@ void handle_input( void )
         }
     }
     
+    /* The board can't change under the next generation while it is being
+       worked out. */
+    threads_finish();
+    
+    /* Skipping to the end of the round or fast-forwarding moves the board
+       on for everyone, so everyone still playing has to ask for it, and it
+       is only done once. */
+    for ( n = 1; n < 10 && ( players[n][0] <= P_DEAD || ready[n] == 'f' );
+          n++ ){};
+    skip = ( n == 10 && ( cycle || loptions[OP_RULES] == OPx_SANDBOX ) );
+    
     /* Now go through and PERFORM the actions. */
     for ( i = 1; i < 10; i++ )
     {
@@ -856,21 +1575,24 @@ void handle_input( void )
                 /* Handle the placement/drawing of the seed/player. */
                 if ( c == bigC || c == '>' )
                 {
-                    if ( lgrid[el(players[i][1]+dx,players[i][2]+dy)] == 0
+                    if ( cell_at( players[i][1]+dx, players[i][2]+dy ) == 0
                          && ( loptions[OP_STARTING_SEEDS] == 0 ||
-                              seeds[i] > 0 ) )
+                              seeds[i] > 0 )
+                         && set_cell( players[i][1]+dx, players[i][2]+dy, i ) )
                     {
-                        lgrid[el(players[i][1]+dx,players[i][2]+dy)] = i;
-                        
                         if ( loptions[OP_STARTING_SEEDS] )
                             seeds[i] --;
+                        hist_n = 0;
+                        cycle = 0;
                     }
                 }
                 else
                 {
                     if ( loptions[OP_OTHER_CELLS] &&
-                         lgrid[el(players[i][1]+dx,players[i][2]+dy)] > 9 &&
-                         lgrid[el(players[i][1]+dx,players[i][2]+dy)]%10 != i )
+                         IS_ALIVE( cell_at( players[i][1]+dx,
+                                            players[i][2]+dy ) ) &&
+                         COLOR_OF( cell_at( players[i][1]+dx,
+                                            players[i][2]+dy ) ) != i )
                     {
                         /* Do nothing. */
                     }
@@ -884,18 +1606,24 @@ void handle_input( void )
                 
             /* Handle hatching seeds. */
             if ( c == ' ' )
+            {
                 players[i][0] = P_HATCHING;
+                hist_n = 0;
+                cycle = 0;
+            }
                 
             /* Do harvesting. */
             else if ( c == ',' )
             {
-                if ( lgrid[ el( players[i][1], players[i][2] ) ]%10 == i 
+                if ( COLOR_OF( cell_at( players[i][1], players[i][2] ) ) == i
                      && loptions[OP_RULES] != OPx_EXTERMINATION )
                 {
                     /* Drop the score if it was a live cell. */
-                    if ( lgrid[ el( players[i][1], players[i][2] ) ] > 9 )
+                    if ( IS_ALIVE( cell_at( players[i][1], players[i][2] ) ) )
                         scores[ i ] --;
-                    lgrid[ el( players[i][1], players[i][2] ) ] = 0;
+                    set_cell( players[i][1], players[i][2], 0 );
+                    hist_n = 0;
+                    cycle = 0;
                     
                     /* Increment the seed stores. */
                     if ( seeds[i] < loptions[OP_MAX_SEEDS] )
@@ -912,6 +1640,40 @@ void handle_input( void )
                as an action. */
             else if ( c == 'e' && loptions[OP_RULES] == OPx_SANDBOX )
                     stasis = ( stasis ) ? 0 : 1;
+            
+            /* Skip to the end of a board that keeps repeating itself. */
+            else if ( c == 'f' && skip == 1 && cycle )
+            {
+                skip_cycle();
+                skip = 2;
+            }
+            
+            /* Fast-forward. Jump ahead a thousand or so generations, but
+               stop short of the generation limit so the game loop still
+               steps into it and ends the round. A board in stasis stays
+               where it is. */
+            else if ( c == 'f' && skip == 1 && stasis )
+            {
+                pmsg( "The board is in stasis. Press 'e' to let it go." );
+                skip = 2;
+            }
+            else if ( c == 'f' && skip == 1 )
+            {
+                n = FAST_FORWARD;
+                if ( loptions[OP_GENERATIONS] )
+                    n = MIN( n, loptions[OP_GENERATIONS] - gen_no );
+                if ( n > 0 )
+                {
+                    fast_forward( n );
+                    find_cycle();
+                }
+                skip = 2;
+            }
+            else if ( c == 'f' && !skip && cycle )
+                pmsg( "Everyone has to press 'f' to skip to the end." );
+            else if ( c == 'f' && !skip &&
+                      loptions[OP_RULES] == OPx_SANDBOX )
+                pmsg( "Everyone has to press 'f' to fast-forward." );
         }
     }
 }
@@ -928,20 +1690,26 @@ void draw_all( int curplayer )
         /* Handle the extra spacing required by the SPACED_GRID parameter. */
         if ( life_opts()[OP_SPACED_GRID] )
         {
-            if ( ( players[curplayer][1] - cam_x < (tw() - STAT_SZ)*.125 ) ||
-                 ( players[curplayer][1] - cam_x > (tw() - STAT_SZ)*.375 ) )
+            if ( ( players[curplayer][1] - (double) cam_x <
+                   (tw() - STAT_SZ)*.125 ) ||
+                 ( players[curplayer][1] - (double) cam_x >
+                   (tw() - STAT_SZ)*.375 ) )
                 cam_x = players[curplayer][1] - (tw() - STAT_SZ)*.25;
         }
         else
         {
-            if ( ( players[curplayer][1] - cam_x < (tw() - STAT_SZ)*.25 ) ||
-                 ( players[curplayer][1] - cam_x > (tw() - STAT_SZ)*.75 ) )
+            if ( ( players[curplayer][1] - (double) cam_x <
+                   (tw() - STAT_SZ)*.25 ) ||
+                 ( players[curplayer][1] - (double) cam_x >
+                   (tw() - STAT_SZ)*.75 ) )
                 cam_x = players[curplayer][1] - (tw() - STAT_SZ)*.50;
         }
         
         /* Vertical alignment is always the same. */
-        if ( ( players[curplayer][2] - cam_y < (th() - MSG_SZ)*.25 ) ||
-             ( players[curplayer][2] - cam_y > (th() - MSG_SZ)*.75 ) )
+        if ( ( players[curplayer][2] - (double) cam_y <
+               (th() - MSG_SZ)*.25 ) ||
+             ( players[curplayer][2] - (double) cam_y >
+               (th() - MSG_SZ)*.75 ) )
             cam_y = players[curplayer][2] - (th() - MSG_SZ)*.50;
     }
     
@@ -992,8 +1760,9 @@ void draw_grid( int x1, int y1, int x2, int y2, int lx, int ly, int curplayer )
             }
             else
             {
-                c = lgrid[ el(lx,ly) ];
-                colorize( colors[c%10] + ((curplayer == c%10) ? 8:0), 0 );
+                c = cell_at( lx, ly );
+                colorize( colors[ COLOR_OF(c) ] +
+                          ((curplayer == COLOR_OF(c)) ? 8:0), 0 );
             }
             
             /* Draw the right token in the right spot. Inefficient, but I don't
@@ -1003,27 +1772,29 @@ void draw_grid( int x1, int y1, int x2, int y2, int lx, int ly, int curplayer )
             /* Based on the glyph set, we print them all. */
             if ( loptions[OP_SERIAL_GLYPHS] )
             {
-                if ( c == 0 )       addch( ' ' );
-                else if ( c == 42 ) addch( '-' );
-                else if ( c == 1 )  addch( '.' );
-                else if ( c < 10 )  addch( 'a'+c-1 );
-                else if ( c == 10 ) addch( '*' );
-                else if ( c == 11 ) addch( 'o' );
-                else                addch( 'A'+c-11 );
+                if ( c == 0 )                   addch( ' ' );
+                else if ( c == 42 )             addch( '-' );
+                else if ( c == 1 )              addch( '.' );
+                else if ( !IS_ALIVE(c) )        addch( 'a'+c-1 );
+                else if ( c == CELL_LIVE )      addch( '*' );
+                else if ( c == ( CELL_LIVE|1 ) ) addch( 'o' );
+                else                            addch( 'A'+COLOR_OF(c)-1 );
             }
             else
             {
-                if ( c == 0 )       addch( ' ' );
-                else if ( c == 42 ) addch( '-' );
-                else if ( c < 10 )  addch( '.' );
-                else                addch( 'o' );
+                if ( c == 0 )                   addch( ' ' );
+                else if ( c == 42 )             addch( '-' );
+                else if ( !IS_ALIVE(c) )        addch( '.' );
+                else                            addch( 'o' );
             }
             
-            lx++;
+            /* Past the far edge, everything is out of bounds. Stopping
+               there keeps the biggest boards from overflowing. */
+            if ( lx < gw ) lx++;
             x1 += ( loptions[OP_SPACED_GRID] ) ? 2 : 1;
         }
         
-        ly++;
+        if ( ly < gh ) ly++;
         y1++;
         
         /* Restore munged variables. */
@@ -1046,8 +1817,8 @@ void draw_grid( int x1, int y1, int x2, int y2, int lx, int ly, int curplayer )
     for ( s1 = 0; s1 < 10; s1++ )
     {
         if ( players[s1][0] > P_DEAD && players[s1][1] >= lx && 
-             players[s1][1] <= lx+s3 && players[s1][2] >= ly &&
-             players[s1][2] <= ly+s4 )
+             players[s1][1]-s3 <= lx && players[s1][2] >= ly &&
+             players[s1][2]-s4 <= ly )
         {
             if ( loptions[OP_SPACED_GRID] )
                 move( players[s1][2]-ly+y1, (players[s1][1]-lx)*2+x1 );
@@ -1107,14 +1878,14 @@ void draw_status( int x1, int y1, int x2, int y2, int curplayer )
         {
             colorize( colors[i] + ((curplayer - i) ? 0 : 8), 0 );
             move( y1+i, x1 );
-            printw( "%d", scores[i] );
+            printw( "%ld", scores[i] );
         }
     }
     colorize( 7, 0 );
     move( y1+7, x1 );
-    printw( "%d", scores[0] );
+    printw( "%ld", scores[0] );
     move( y1+8, x1 );
-    printw( " / %d", gw*gh );
+    printw( " / %.0f", (double) gw*gh );
     
     colorize( colors[ curplayer ], 0 );
     
@@ -1177,189 +1948,1918 @@ void draw_messages( int x1, int y1, int x2, int y2 )
 }
 
 
-/* Iterate the board over one generation of Life, handling colorization as
-   well. This is so horribly inefficient, but for a 7DRL, I'm not concerned
-   with efficiency. */
-void next_generation( void )
+/* Returns true if the rulestring is deterministic (every value 0 or 100), in
+   which case the bit-parallel engines can handle this generation. Their rule
+   masks are stored in smask and bmask. */
+static int deterministic_rules( int *smask, int *bmask )
 {
-    int i, j;              /*< Iterators. */
-    int neighbors[10];     /*< Colored neighbor counters. */
-    int c, m, b, t, w;     /*< Counters. */
+    int i;                  /*< Iterator. */
+    
+    *smask = 0;
+    *bmask = 0;
+    for ( i = 0; i < 9; i++ )
+    {
+        if ( loptions[OP_RULESTRING_S(i)] % 100 ||
+             loptions[OP_RULESTRING_B(i)] % 100 )
+            return 0;
+        
+        if ( loptions[OP_RULESTRING_S(i)] ) *smask |= 1 << i;
+        if ( loptions[OP_RULESTRING_B(i)] ) *bmask |= 1 << i;
+    }
+    
+    return 1;
+}
+
+
+/* Returns true if there are no colored cells on the board, so colors never
+   matter and the bit-packed engine will do. */
+static int colorless_board( void )
+{
+    int i;                  /*< Iterator. */
+    
+    for ( i = 1; i < 10 && scores[i] == 0; i++ ){};
+    return ( i == 10 );
+}
+
+
+/* Spawn the seeds of every player that has designated hatching. Seeds that
+   had a cell born on top of them this generation are already gone. */
+static void hatch_seeds( void )
+{
+    int i, j;               /*< Iterators. */
+    char *c;                /*< The cell. */
+    
+    for ( i = 1; i < 10 && players[i][0] != P_HATCHING; i++ ){};
+    if ( i == 10 )
+        return;
     
-    /* First, we store all of our neighbors in wgrid. The only option that
-       affects this is OP_GRID_WRAP. We store this as a 2-digit decimal
-       number. [color_of_neighbors][number_of_neighbors] */
     for ( i = 0; i < gh; i++ )
     {
         for ( j = 0; j < gw; j++ )
         {
-            memset( neighbors, 0, sizeof(int)*10 );
-            wgrid[ el(j,i) ] = 0;
-            
-            /* It's easiest to break the counting into wrapping and not-
-               wrapping. In wrapped mode, there is always a neighbor. */
-            if ( loptions[OP_GRID_WRAP] )
+            c = lgrid + el(j,i);
+            if ( *c && !IS_ALIVE(*c) && players[ (int) *c ][0] == P_HATCHING )
             {
-                /* Temporary evaluations. */
-                m = (j)?(j-1):(gw-1);       /* j-1 */
-                b = (i)?(i-1):(gh-1);       /* i-1 */
-                t = (j<gw-1)?(j+1):(0);     /* j+1 */
-                w = (i<gh-1)?(i+1):(0);     /* i+1 */
-                
-                /* Top left. */
-                c = lgrid[el( m,b )];
-                if ( c > 9 )
-                    neighbors[ c%10 ] ++;
-                
-                /* Top. */
-                c = lgrid[el( j,b )];
-                if ( c > 9 )
-                    neighbors[ c%10 ] ++;
-                
-                /* Top right. */
-                c = lgrid[el( t,b )];
-                if ( c > 9 )
-                    neighbors[ c%10 ] ++;
-                
-                /* Left. */
-                c = lgrid[el( m,i )];
-                if ( c > 9 )
-                    neighbors[ c%10 ] ++;
-                
-                /* Right. */
-                c = lgrid[el( t,i )];
-                if ( c > 9 )
-                    neighbors[ c%10 ] ++;
-                
-                /* Bottom left. */
-                c = lgrid[el( m,w )];
-                if ( c > 9 )
-                    neighbors[ c%10 ] ++;
-                
-                /* Bottom. */
-                c = lgrid[el( j,w )];
-                if ( c > 9 )
-                    neighbors[ c%10 ] ++;
-                
-                /* Bottom right. */
-                c = lgrid[el( t,w )];
-                if ( c > 9 )
-                    neighbors[ c%10 ] ++;
+                *c |= CELL_LIVE;
+                scores[ COLOR_OF(*c) ] ++;
+                tiles_mark( j, i );
             }
-            else
+        }
+    }
+}
+
+
+/* Turn off all players set to hatching. Also, if a player is standing on an
+   opposing color's cell while DEADLY is running, set him to dead. */
+static void end_generation( void )
+{
+    int i;                  /*< Iterator. */
+    
+    for ( i = 0; i < 10; i++ )
+    {
+        if ( players[i][0] == P_HATCHING )
+            players[i][0] = P_PLAYING;
+            
+        if ( loptions[OP_OTHER_CELLS] == OPx_DEADLY &&
+             players[i][0] == P_PLAYING &&
+             IS_ALIVE( cell_at( players[i][1], players[i][2] ) ) &&
+             COLOR_OF( cell_at( players[i][1], players[i][2] ) ) &&
+             COLOR_OF( cell_at( players[i][1], players[i][2] ) ) != i )
+            players[i][0] = P_DEAD;
+    }
+}
+
+
+/* Fill the border around the life grid. When the grid wraps, the border
+   holds copies of the cells on the opposite edges. Otherwise it is dead. */
+static void fill_border( void )
+{
+    int i, wrap = loptions[OP_GRID_WRAP];   /*< Iterator and wrapping. */
+    
+    for ( i = 0; i < gh; i++ )
+    {
+        lgrid[ el(-1,i) ] = ( wrap ) ? lgrid[ el(gw-1,i) ] : 0;
+        lgrid[ el(gw,i) ] = ( wrap ) ? lgrid[ el(0,i) ] : 0;
+    }
+    
+    if ( wrap )
+    {
+        memcpy( lgrid + el(-1,-1), lgrid + el(-1,gh-1), sizeof(char)*(gw+2) );
+        memcpy( lgrid + el(-1,gh), lgrid + el(-1,0), sizeof(char)*(gw+2) );
+    }
+    else
+    {
+        memset( lgrid + el(-1,-1), 0, sizeof(char)*(gw+2) );
+        memset( lgrid + el(-1,gh), 0, sizeof(char)*(gw+2) );
+    }
+}
+
+
+/* Fill in the majority tables. These never change. */
+static void build_majors( void )
+{
+    int h, i, c;            /*< Iterators. */
+    int m, b, k;            /*< Best count, its color and a count. */
+    
+    for ( h = 0; h < 2; h++ )
+    {
+        for ( i = 0; i < 4096; i++ )
+        {
+            m = 0;
+            b = 0;
+            for ( c = 0; c < 3; c++ )
             {
-                /* Check top neighbors. */
-                if ( i > 0 )
+                k = ( i >> 4*c ) & 15;
+                if ( k > m )
                 {
-                    if ( j > 0 && lgrid[ el(j-1,i-1) ] > 9 )
-                        neighbors[ lgrid[ el(j-1,i-1) ] % 10 ] ++;
-                    if ( lgrid[ el(j,i-1) ] > 9 )
-                        neighbors[ lgrid[ el(j,i-1) ] % 10 ] ++;
-                    if ( j < gw-1 && lgrid[ el(j+1,i-1) ] > 9 )
-                        neighbors[ lgrid[ el(j+1,i-1) ] % 10 ] ++;
+                    m = k;
+                    b = 1 + c + 3*h;
                 }
-                
-                /* Check left neighbor. */
-                if ( j > 0 && lgrid[ el(j-1,i) ] > 9 )
-                    neighbors[ lgrid[ el(j-1,i) ] % 10 ] ++;
-                
-                /* Check right neighbor. */
-                if ( j < gw-1 && lgrid[ el(j+1,i) ] > 9 )
-                    neighbors[ lgrid[ el(j+1,i) ] % 10 ] ++;
-                
-                /* Check bottom neighbors. */
-                if ( i < gh-1 )
+                else if ( k == m )
+                    b = 0;
+            }
+            majors[h][i] = m*16 + b;
+        }
+    }
+}
+
+
+/* Find the majority color of the packed neighbor counters n, or 0 if there
+   is a tie. Each half of the colors has its own table, and the winner of
+   the bigger half wins. */
+static int majority( unsigned long n )
+{
+    int lo = majors[0][ ( n >> 4 ) & 0xfff ];   /*< Colors 1-3. */
+    int hi = majors[1][ ( n >> 16 ) & 0xfff ];  /*< Colors 4-6. */
+    
+    if ( ( lo >> 4 ) > ( hi >> 4 ) )
+        return lo & 15;
+    if ( ( hi >> 4 ) > ( lo >> 4 ) )
+        return hi & 15;
+    return 0;
+}
+
+
+/* Compile the rulestrings into the rule table, with the seeds of the players
+   in the hatch mask hatching if nothing is born on top of them. The regular
+   engine only needs to roll the dice and look up the answer. A chance of 0
+   or 100 means the roll makes no difference. */
+static void build_rules( int hatch )
+{
+    int v, t, b;            /*< Cell, neighbor count and majority color. */
+    
+    /* If the cell is alive, check the Survival rulestring. If not, check the
+       Birth rulestring. The rules of birth take precedence over seed
+       hatching. */
+    for ( v = 0; v < CELL_STATES; v++ )
+    {
+        for ( t = 0; t < 9; t++ )
+        {
+            if ( IS_ALIVE(v) )
+                chances[v][t] = loptions[OP_RULESTRING_S( t )];
+            else
+                chances[v][t] = loptions[OP_RULESTRING_B( t )];
+        }
+        
+        for ( b = 0; b < 8; b++ )
+            passes[v][b] = ( IS_ALIVE(v) && !b ) ? v : CELL_LIVE|b;
+        
+        if ( IS_ALIVE(v) )
+            fails[v] = 0;
+        else
+            fails[v] = ( v > 0 && ( hatch & (1<<v) ) ) ? v|CELL_LIVE : v;
+    }
+    
+    /* The majority tables come along for the ride. */
+    build_majors();
+    
+    for ( t = 0; t < 9; t++ )
+    {
+        rule_opts[t] = loptions[OP_RULESTRING_S( t )];
+        rule_opts[9+t] = loptions[OP_RULESTRING_B( t )];
+    }
+    rule_hatch = hatch;
+}
+
+
+/* Has anything the rule table was built from changed? */
+static int rules_changed( int hatch )
+{
+    int t;                  /*< Iterator. */
+    
+    if ( hatch != rule_hatch )
+        return 1;
+    for ( t = 0; t < 9; t++ )
+    {
+        if ( rule_opts[t] != loptions[OP_RULESTRING_S( t )] ||
+             rule_opts[9+t] != loptions[OP_RULESTRING_B( t )] )
+            return 1;
+    }
+    return 0;
+}
+
+
+/* Roll the dice for the cell at x,y in generation gen, giving a value from
+   0-99, each as likely as the next. Every cell of every generation has its
+   own roll, so it doesn't matter who rolls for the cell, when, or whether
+   other cells are rolled for at all. Rolls come four at a time, for four
+   cells in a row counting across rows from the top left: r keeps the last
+   four, which were for block *blk of this generation. */
+static int roll( int x, int y, int gen, unsigned long *r, unsigned long *blk )
+{
+    unsigned long k = (unsigned long) y*gw + x;    /*< The number of the
+                                                      cell. */
+    
+    if ( k >> 2 != *blk )
+    {
+        *blk = k >> 2;
+        rnd_cells_below( game_seed, gen, k & ~3UL, 100, r );
+    }
+    return (int) r[ k & 3 ];
+}
+
+
+/* Find the next state of cell v, given its number of neighbors t, their
+   majority color b and a random value c from 0-99. Score changes go to
+   delta. */
+static int rule_cell( int v, int t, int b, int c, long *delta )
+{
+    int n = ( c < chances[v][t] ) ? passes[v][b] : fails[v];  /*< The next
+                                                                 state. */
+    
+    if ( n != v )
+    {
+        if ( IS_ALIVE(v) ) delta[ COLOR_OF(v) ] --;
+        if ( IS_ALIVE(n) ) delta[ COLOR_OF(n) ] ++;
+    }
+    return n;
+}
+
+
+/* Work out the next generation of the rows from y0 up to y1 in one sweep,
+   reading lgrid and writing wgrid. Score changes go to delta. */
+static void step_rows( int y0, int y1, long *delta )
+{
+    int i, j;              /*< Iterators. */
+    unsigned long n;       /*< Colored neighbor counters. */
+    unsigned long r[4];    /*< Random numbers... */
+    unsigned long k = ~0UL; /*< ...and the block they belong to. */
+    int c, b, t;           /*< Counters. */
+    int around[8];         /*< Where the neighbors are, from the cell. */
+    const char *cell;      /*< The cell in the grid. */
+    
+    around[0] = -gw-3;  around[1] = -gw-2;  around[2] = -gw-1;
+    around[3] = -1;                         around[4] = 1;
+    around[5] = gw+1;   around[6] = gw+2;   around[7] = gw+3;
+    
+    /* For every cell, we count the neighbors and find their majority color.
+       The border takes care of OP_GRID_WRAP, so every cell has exactly eight
+       neighbors. Then we roll the dice and set life/death right away. */
+    for ( i = y0; i < y1; i++ )
+    {
+        for ( j = 0; j < gw; j++ )
+        {
+            cell = lgrid + el(j,i);
+            n = counter[ (int) cell[ around[0] ] ] +
+                counter[ (int) cell[ around[1] ] ] +
+                counter[ (int) cell[ around[2] ] ] +
+                counter[ (int) cell[ around[3] ] ] +
+                counter[ (int) cell[ around[4] ] ] +
+                counter[ (int) cell[ around[5] ] ] +
+                counter[ (int) cell[ around[6] ] ] +
+                counter[ (int) cell[ around[7] ] ];
+            
+            /* Now we count the neighbors and determine the new color of this
+               cell. The total is the sum of the counters, which the multiply
+               adds up in the top one. */
+            t = (int) ( ( n * 0x1111111UL ) >> 24 ) & 15;
+            b = majority( n );
+            
+            /* Only roll the dice if they could change the outcome. A roll
+               of 0 passes a chance of 100 and fails a chance of 0. */
+            c = chances[ (int) *cell ][t];
+            c = ( c > 0 && c < 100 ) ? roll( j, i, gen_no, r, &k ) : 0;
+            wgrid[ el(j,i) ] = rule_cell( *cell, t, b, c, delta );
+        }
+    }
+}
+
+
+/* The same as step_rows(), but faster. We keep the sum of every column of
+   three cells around the row, with a 4-bit counter for every color packed
+   into a word. Moving along the row adds one column sum and takes away
+   another, and moving down a row adds one cell to every column sum and
+   takes away another. cs has room for gw+3 sums. */
+static void sum_rows( int y0, int y1, long *delta, unsigned long *cs )
+{
+    int i, j;              /*< Iterators. */
+    int c, b, t;           /*< Counters. */
+    unsigned long n, win;  /*< Neighbor counts and the window around them. */
+    unsigned long r[4];    /*< Random numbers... */
+    unsigned long k = ~0UL; /*< ...and the block they belong to. */
+    const char *up, *mid, *down;    /*< Rows, starting at the border. */
+    
+    if ( y0 >= y1 )
+        return;
+    
+    /* Add up the columns around the first row, border and all. The extra
+       sum past the end keeps the window from running off the end. */
+    up = lgrid + el(-1,y0-1);
+    mid = lgrid + el(-1,y0);
+    down = lgrid + el(-1,y0+1);
+    for ( j = 0; j < gw+2; j++ )
+        cs[j] = counter[ (int) up[j] ] + counter[ (int) mid[j] ] +
+                counter[ (int) down[j] ];
+    cs[gw+2] = 0;
+    
+    for ( i = y0; i < y1; i++ )
+    {
+        mid = lgrid + el(-1,i);
+        win = cs[0] + cs[1] + cs[2];
+        for ( j = 0; j < gw; j++ )
+        {
+            /* Everything in the window but the cell itself. No counter can
+               go past 9, so they never carry into each other. */
+            n = win - counter[ (int) mid[j+1] ];
+            win += cs[j+3];
+            win -= cs[j];
+            
+            /* The total and majority color are found the same way as
+               always. */
+            t = (int) ( ( n * 0x1111111UL ) >> 24 ) & 15;
+            b = majority( n );
+            
+            c = chances[ (int) mid[j+1] ][t];
+            c = ( c > 0 && c < 100 ) ? roll( j, i, gen_no, r, &k ) : 0;
+            wgrid[ el(j,i) ] = rule_cell( mid[j+1], t, b, c, delta );
+        }
+        
+        /* Slide the column sums down a row. */
+        if ( i < y1-1 )
+        {
+            up = lgrid + el(-1,i-1);
+            down = lgrid + el(-1,i+2);
+            for ( j = 0; j < gw+2; j++ )
+            {
+                cs[j] += counter[ (int) down[j] ];
+                cs[j] -= counter[ (int) up[j] ];
+            }
+        }
+    }
+}
+
+
+/* One thread's share of a generation, which is a band of rows. The random
+   numbers come from the cells themselves, so the game plays out the same
+   with any number of threads. The first thread fills the border while the
+   rest wait. arg is not used. */
+static void generation_job( int id, int n, void *arg )
+{
+    int y0, y1;             /*< Iterators. */
+    long delta[10];         /*< Our score changes. */
+    
+    (void) arg;
+    if ( id == 0 )
+        fill_border();
+    threads_wait();
+    
+    threads_band( id, n, gh, &y0, &y1 );
+    memset( delta, 0, sizeof(long)*10 );
+    
+    if ( csums != NULL && loptions[OP_KERNEL] == OPx_COLUMNS )
+        sum_rows( y0, y1, delta, csums + (gw+3)*id );
+    else
+        step_rows( y0, y1, delta );
+    memcpy( deltas[id], delta, sizeof(long)*10 );
+}
+
+
+/* The next state of the cell v at x,y on a sparse board, given the counters
+   of its neighbors n. The dice are the same ones the grids would roll, and
+   score changes go straight to the scores. */
+static int sparse_rule( unsigned long x, unsigned long y, int v,
+                        unsigned long n )
+{
+    unsigned long r[4];     /*< Random numbers. */
+    unsigned long k;        /*< The number of the cell. */
+    int c, t;               /*< Counters. */
+    
+    t = (int) ( ( n * 0x1111111UL ) >> 24 ) & 15;
+    c = chances[v][t];
+    if ( c > 0 && c < 100 )
+    {
+        k = y*gw + x;
+        rnd_cells_below( game_seed, gen_no, k & ~3UL, 100, r );
+        c = (int) r[ k & 3 ];
+    }
+    else
+        c = 0;
+    
+    return rule_cell( v, t, majority( n ), c, scores );
+}
+
+
+/* Where column x is on the board, or -1 if it's off the edge. */
+static int board_col( int x )
+{
+    if ( loptions[OP_GRID_WRAP] )
+        return ( x % gw + gw ) % gw;
+    return ( x < 0 || x >= gw ) ? -1 : x;
+}
+
+
+/* Where row y is on the board, or -1 if it's off the edge. */
+static int board_row( int y )
+{
+    if ( loptions[OP_GRID_WRAP] )
+        return ( y % gh + gh ) % gh;
+    return ( y < 0 || y >= gh ) ? -1 : y;
+}
+
+
+/* Move the w by h cells in src along one generation into dst, all but the
+   outermost s of them on every side, which can't be known without the cells
+   around them. The cells are on the board at the columns and rows in gx and
+   gy, which give the dice, and cells off the edge of the board stay dead.
+   gen is the generation being worked out, and cs has room for w+1 sums. */
+static void block_step( const char *src, char *dst, int w, int h, int s,
+                        const int *gx, const int *gy, int gen,
+                        unsigned long *cs )
+{
+    int i, j;              /*< Iterators. */
+    int c, t, v;           /*< Counters and the cell. */
+    unsigned long n, win;  /*< Neighbor counts and the window around them. */
+    unsigned long r[4];    /*< Random numbers... */
+    unsigned long k = ~0UL; /*< ...and the block they belong to. */
+    const char *up, *mid, *down;    /*< Rows. */
+    
+    /* The column sums work the same as in sum_rows(). */
+    up = src + (s-1)*w;
+    mid = src + s*w;
+    down = src + (s+1)*w;
+    for ( j = s-1; j < w-s+1; j++ )
+        cs[j] = counter[ (int) up[j] ] + counter[ (int) mid[j] ] +
+                counter[ (int) down[j] ];
+    cs[w-s+1] = 0;
+    
+    for ( i = s; i < h-s; i++ )
+    {
+        mid = src + i*w;
+        win = cs[s-1] + cs[s] + cs[s+1];
+        for ( j = s; j < w-s; j++ )
+        {
+            v = mid[j];
+            n = win - counter[v];
+            win += cs[j+2];
+            win -= cs[j-1];
+            
+            if ( gx[j] < 0 || gy[i] < 0 )
+            {
+                dst[ i*w + j ] = 0;
+                continue;
+            }
+            
+            t = (int) ( ( n * 0x1111111UL ) >> 24 ) & 15;
+            c = chances[v][t];
+            c = ( c > 0 && c < 100 ) ? roll( gx[j], gy[i], gen, r, &k ) : 0;
+            dst[ i*w + j ] = ( c < chances[v][t] ) ? passes[v][ majority( n ) ]
+                                                   : fails[v];
+        }
+        
+        if ( i < h-s-1 )
+        {
+            up = src + (i-1)*w;
+            down = src + (i+2)*w;
+            for ( j = s-1; j < w-s+1; j++ )
+            {
+                cs[j] += counter[ (int) down[j] ];
+                cs[j] -= counter[ (int) up[j] ];
+            }
+        }
+    }
+}
+
+
+/* One thread's share of a run of generations done a block at a time, which
+   is a band of rows of blocks. Each block is copied out of lgrid along with
+   the k cells around it, moved along k generations while it's in the cache,
+   and written to wgrid. Whatever the cells around it got wrong can't reach
+   the block in time. arg points to k, or is NULL for one generation. */
+static void block_job( int id, int n, void *arg )
+{
+    int k = ( arg ) ? *(int *) arg : 1; /*< The number of generations. */
+    long delta[10];                 /*< Our score changes. */
+    char buf[2][BLOCK_P*BLOCK_P];   /*< The block and its next generation. */
+    unsigned long cs[BLOCK_P+1];    /*< Column sums. */
+    int gx[BLOCK_P], gy[BLOCK_P];   /*< Where the block is on the board. */
+    int bx, by, w, h;               /*< The block and its size with the cells
+                                        around it. */
+    int y0, y1, i, j, s, v;         /*< Iterators and cells. */
+    const char *c;                  /*< The last generation. */
+    
+    threads_band( id, n, ( gh + BLOCK_SZ - 1 ) / BLOCK_SZ, &y0, &y1 );
+    memset( delta, 0, sizeof(long)*10 );
+    
+    for ( by = y0*BLOCK_SZ; by < y1*BLOCK_SZ && by < gh; by += BLOCK_SZ )
+    {
+        /* A board kept in a file is read in a row of blocks ahead. */
+        if ( mapped && by + BLOCK_SZ < gh )
+        {
+            grid_ahead( lgrid + el(-1,by+BLOCK_SZ),
+                        (size_t) (gw+2)*BLOCK_SZ );
+            grid_ahead( wgrid + el(-1,by+BLOCK_SZ),
+                        (size_t) (gw+2)*BLOCK_SZ );
+        }
+        
+        for ( bx = 0; bx < gw; bx += BLOCK_SZ )
+        {
+            w = MIN( BLOCK_SZ, gw-bx ) + 2*k;
+            h = MIN( BLOCK_SZ, gh-by ) + 2*k;
+            for ( j = 0; j < w; j++ )
+                gx[j] = board_col( bx-k+j );
+            for ( i = 0; i < h; i++ )
+                gy[i] = board_row( by-k+i );
+            
+            for ( i = 0; i < h; i++ )
+            {
+                for ( j = 0; j < w; j++ )
+                    buf[0][ i*w + j ] = ( gx[j] < 0 || gy[i] < 0 ) ? 0 :
+                                        lgrid[ at(gx[j],gy[i]) ];
+            }
+            
+            for ( s = 1; s <= k; s++ )
+                block_step( buf[(s-1)&1], buf[s&1], w, h, s, gx, gy,
+                            gen_no+s-1, cs );
+            
+            /* Only the block itself is right. */
+            c = buf[k&1];
+            for ( i = k; i < h-k; i++ )
+            {
+                for ( j = k; j < w-k; j++ )
                 {
-                    if ( j > 0 && lgrid[ el(j-1,i+1) ] > 9 )
-                        neighbors[ lgrid[ el(j-1,i+1) ] % 10 ] ++;
-                    if ( lgrid[ el(j,i+1) ] > 9 )
-                        neighbors[ lgrid[ el(j,i+1) ] % 10 ] ++;
-                    if ( j < gw-1 && lgrid[ el(j+1,i+1) ] > 9 )
-                        neighbors[ lgrid[ el(j+1,i+1) ] % 10 ] ++;
+                    v = lgrid[ at(gx[j],gy[i]) ];
+                    if ( IS_ALIVE(v) ) delta[ COLOR_OF(v) ] --;
+                    v = c[ i*w + j ];
+                    if ( IS_ALIVE(v) ) delta[ COLOR_OF(v) ] ++;
+                    wgrid[ at(gx[j],gy[i]) ] = v;
                 }
             }
+        }
+    }
+    memcpy( deltas[id], delta, sizeof(long)*10 );
+}
+
+
+/* Unpack row y of lgrid, kept two cells to a byte, into row, with the
+   cells next to either end in row[-1] and row[gw]. Rows off the edge of the
+   board are dead. */
+static void unpack_row( int y, char *row )
+{
+    const unsigned char *src;   /*< The packed row. */
+    int j;                      /*< Iterator. */
+    
+    y = board_row( y );
+    if ( y < 0 )
+    {
+        memset( row-1, 0, sizeof(char)*(gw+2) );
+        return;
+    }
+    
+    src = (const unsigned char *) lgrid + nib(0,y);
+    for ( j = 0; j < gw; j += 2 )
+    {
+        row[j] = (char) ( src[j>>1] & 15 );
+        row[j+1] = (char) ( src[j>>1] >> 4 );
+    }
+    row[-1] = ( loptions[OP_GRID_WRAP] ) ? row[gw-1] : 0;
+    row[gw] = ( loptions[OP_GRID_WRAP] ) ? row[0] : 0;
+}
+
+
+/* One thread's share of a generation on grids kept two cells to a byte. The
+   rows around the one being worked on are unpacked into a window of three,
+   which slides down the band, and the cells go through the rule table the
+   same way as in step_rows(). Every row starts on a byte of its own, so no
+   two threads ever write the same one. arg is not used. */
+static void packed_job( int id, int n, void *arg )
+{
+    int i, j, y0, y1;       /*< Iterators. */
+    long delta[10];         /*< Our score changes. */
+    unsigned long m;        /*< Colored neighbor counters. */
+    unsigned long r[4];     /*< Random numbers... */
+    unsigned long k = ~0UL; /*< ...and the block they belong to. */
+    int c, b, t, v;         /*< Counters and the next state. */
+    char *up, *mid, *down;  /*< The window, each row past its border. */
+    unsigned char *dst;     /*< The packed row being written. */
+    
+    (void) arg;
+    threads_band( id, n, gh, &y0, &y1 );
+    memset( delta, 0, sizeof(long)*10 );
+    
+    up = unpacked + 3*(gw+2)*id + 1;
+    mid = up + gw+2;
+    down = mid + gw+2;
+    if ( y0 < y1 )
+    {
+        unpack_row( y0-1, up );
+        unpack_row( y0, mid );
+    }
+    
+    for ( i = y0; i < y1; i++ )
+    {
+        unpack_row( i+1, down );
+        dst = (unsigned char *) wgrid + nib(0,i);
+        for ( j = 0; j < gw; j++ )
+        {
+            m = counter[ (int) up[j-1] ] + counter[ (int) up[j] ] +
+                counter[ (int) up[j+1] ] + counter[ (int) mid[j-1] ] +
+                counter[ (int) mid[j+1] ] + counter[ (int) down[j-1] ] +
+                counter[ (int) down[j] ] + counter[ (int) down[j+1] ];
+            t = (int) ( ( m * 0x1111111UL ) >> 24 ) & 15;
+            b = majority( m );
             
-            /* Now we count the neighbors and determine the new color of this
-               cell. */
-            t = neighbors[0];   /* The total number of neighbors. */
-            b = 0;              /* The ID of the best color. */
-            m = 0;              /* The highest value of colors. */
-            w = 0;              /* Warning that there may be a tie. */
-            for ( c = 1; c < 10; c++ )
+            c = chances[ (int) mid[j] ][t];
+            c = ( c > 0 && c < 100 ) ? roll( j, i, gen_no, r, &k ) : 0;
+            v = rule_cell( mid[j], t, b, c, delta );
+            if ( j & 1 )
+                dst[j>>1] |= (unsigned char) ( v << 4 );
+            else
+                dst[j>>1] = (unsigned char) v;
+        }
+        
+        /* Slide the window down a row. */
+        dst = (unsigned char *) up;
+        up = mid;
+        mid = down;
+        down = (char *) dst;
+    }
+    memcpy( deltas[id], delta, sizeof(long)*10 );
+}
+
+
+/* Make sure the rule table is the one for the players hatching this
+   generation. It only has to be rebuilt when the rulestrings or the
+   hatching players change. */
+static void hatch_rules( void )
+{
+    int i, w;               /*< Iterator and the hatching players. */
+    
+    for ( i = 1, w = 0; i < 10; i++ )
+    {
+        if ( players[i][0] == P_HATCHING )
+            w |= 1 << i;
+    }
+    if ( rules_changed( w ) )
+        build_rules( w );
+}
+
+
+/* Move the board along k generations (at most BLOCK_K) in one pass over the
+   grids instead of k, so boards too big for the cache are only read from
+   memory once. The board comes out exactly as k calls to next_generation()
+   would leave it, except that the generators are only looked at once, at the
+   end. Seeds that hatch all do so in the first generation, so the rules for
+   it work for the rest. */
+static void block_generations( int k )
+{
+    int i, j;              /*< Iterators. */
+    char *swap;            /*< Grid swapper. */
+    
+    hatch_rules();
+    last_engine = 0;
+    threads_run( block_job, &k );
+    for ( i = 0; i < threads_count(); i++ )
+    {
+        for ( j = 0; j < 10; j++ )
+            scores[j] += deltas[i][j];
+    }
+    
+    swap = lgrid;
+    lgrid = wgrid;
+    wgrid = swap;
+    
+    tiles_mark_all();
+    end_generation();
+}
+
+
+/* Step the board in bands of rows, one for each thread, then add up the
+   score changes of every band and flip the grids. */
+static void regular_step( void )
+{
+    int i, j;              /*< Iterators. */
+    char *swap;            /*< Grid swapper. */
+    
+    hatch_rules();
+    last_engine = 0;
+    threads_run( generation_job, NULL );
+    for ( i = 0; i < threads_count(); i++ )
+    {
+        for ( j = 0; j < 10; j++ )
+            scores[j] += deltas[i][j];
+    }
+    
+    swap = lgrid;
+    lgrid = wgrid;
+    wgrid = swap;
+    
+    end_generation();
+}
+
+
+/* The fast paths for deterministic rules. No random numbers are drawn
+   because they could not change the outcome anyways. Only the tiles near the
+   last changes are worked on. The bit-packed engine keeps its own copy of
+   the board, so everything has to be looked at again when we switch
+   between it and the bit-sliced one. */
+static void bits_step( void )
+{
+    int i, j;              /*< Iterators. */
+    int m, b, w;           /*< Rule masks. */
+    
+    deterministic_rules( &m, &b );
+    j = ( colorless_board() ) ? 1 : 2;
+    if ( j != last_engine )
+        tiles_mark_all();
+    last_engine = j;
+    
+    if ( last_engine == 1 )
+    {
+        tiles_begin();
+        if ( !bb_generation( lgrid + el(0,0), gw, gh, gw+2,
+                             loptions[OP_GRID_WRAP], m, b, scores ) )
+        {
+            /* There is no room for the packed rows, so the regular engine
+               takes this generation. */
+            regular_step();
+            return;
+        }
+        hatch_seeds();
+    }
+    else
+    {
+        /* Hatching seeds can be anywhere on the board. */
+        for ( i = 1, w = 0; i < 7; i++ )
+        {
+            if ( players[i][0] == P_HATCHING )
+                w |= 1 << i;
+        }
+        if ( w )
+            tiles_mark_all();
+        
+        tiles_begin();
+        if ( !bs_generation( lgrid + el(0,0), gw, gh, gw+2,
+                             loptions[OP_GRID_WRAP], m, b, w, scores ) )
+        {
+            regular_step();
+            return;
+        }
+    }
+    end_generation();
+}
+
+
+/* Work on the board a block at a time. */
+static void blocked_step( void )
+{
+    block_generations( 1 );
+}
+
+
+/* Step the board kept two cells to a byte in bands of rows, the same as
+   the regular engine. */
+static void packed_step( void )
+{
+    int i, j;              /*< Iterators. */
+    char *swap;            /*< Grid swapper. */
+    
+    hatch_rules();
+    last_engine = 0;
+    threads_run( packed_job, NULL );
+    for ( i = 0; i < threads_count(); i++ )
+    {
+        for ( j = 0; j < 10; j++ )
+            scores[j] += deltas[i][j];
+    }
+    
+    swap = lgrid;
+    lgrid = wgrid;
+    wgrid = swap;
+    
+    end_generation();
+}
+
+
+/* Only look at the cells of a sparse board and their neighbors, one at a
+   time. */
+static void sparse_step( void )
+{
+    hatch_rules();
+    last_engine = 0;
+    if ( !sp_generation( counter, sparse_rule ) )
+        pmsg( "There is no room for the next generation!" );
+    end_generation();
+}
+
+
+/* Can the board be kept in grids? Whether there is memory enough for them
+   is up to grid_alloc(). */
+static int dense_fits( void )
+{
+    return ( gw <= DENSE_MAX && gh <= DENSE_MAX &&
+             (double) ( gw + 64 ) * ( gh + 64 ) < (double) (size_t) -1 );
+}
+
+
+/* Can the bit-parallel engines run the board? */
+static int bits_fit( void )
+{
+    int m, b;              /*< Rule masks. */
+    
+    return ( dense_fits() && deterministic_rules( &m, &b ) );
+}
+
+
+/* Is there a board file to keep the board in? */
+static int mapped_fits( void )
+{
+    return ( board_name != NULL && dense_fits() );
+}
+
+
+/* Any board will do, as long as no cell is born with no neighbors. Those
+   could be born anywhere on the board, so a sparse board would have to keep
+   every cell of it. */
+static int sparse_fits( void )
+{
+    return ( !loptions[OP_RULESTRING_B(0)] );
+}
+
+
+/* Every engine, the fastest first. The first one that can run the board is
+   the one it gets, unless the player asked for another. If there isn't
+   enough memory for it, the next one that can run the board gets it. */
+static const struct engine engines[] =
+{
+    { "bit-packed", bits_fit, dense_init, bits_step,
+      dense_get, dense_set, NULL, TILE_H },
+    { "regular", dense_fits, dense_init, regular_step,
+      dense_get, dense_set, generation_job, 1 },
+    { "blocked", dense_fits, dense_init, blocked_step,
+      dense_get, dense_set, block_job, BLOCK_SZ },
+    { "packed", dense_fits, packed_init, packed_step,
+      packed_get, packed_set, NULL, 1 },
+    { "tiled", dense_fits, tiled_init, blocked_step,
+      tiled_get, tiled_set, block_job, BLOCK_SZ },
+    { "mapped", mapped_fits, mapped_init, blocked_step,
+      dense_get, dense_set, block_job, 0 },
+    { "sparse", sparse_fits, sparse_init, sparse_step,
+      sparse_get, sparse_set, NULL, 0 },
+    { NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0 }
+};
+
+
+/* The engine called name, or NULL if there is none. */
+static const struct engine *engine_named( const char *name )
+{
+    int i;                 /*< Iterator. */
+    
+    for ( i = 0; engines[i].name != NULL; i++ )
+    {
+        if ( strcmp( engines[i].name, name ) == 0 )
+            return engines + i;
+    }
+    return NULL;
+}
+
+
+/* Can engine e run this board? */
+static int engine_fits( const struct engine *e )
+{
+    return e->fits();
+}
+
+
+/* Ask for the engine called name instead of letting the game pick. Returns
+   0 if there is no such engine. */
+int force_engine( const char *name )
+{
+    if ( engine_named( name ) == NULL )
+        return 0;
+    
+    wanted = name;
+    return 1;
+}
+
+
+/* Keep the board in the file called name, picking up the board in it if
+   there is one. */
+void keep_board( const char *name )
+{
+    board_name = name;
+    can_resume = 1;
+    force_engine( "mapped" );
+}
+
+
+/* Pick the engine for a gw by gh board with the current options. Returns 0
+   if none of them can run it. */
+int pick_engine( void )
+{
+    int i;                 /*< Iterator. */
+    
+    eng = ( wanted != NULL ) ? engine_named( wanted ) : NULL;
+    if ( eng != NULL && engine_fits( eng ) )
+        return 1;
+    
+    for ( i = 0; engines[i].name != NULL && !engine_fits( engines + i );
+          i++ ){};
+    if ( engines[i].name == NULL )
+    {
+        pmsg( "No engine can run a board this big with cells born with no "
+              "neighbors." );
+        return 0;
+    }
+    if ( eng != NULL )
+    {
+        sprintf( wbuffer, "The %s engine can't run this board, so the %s "
+                          "engine will.", eng->name, engines[i].name );
+        pmsg( wbuffer );
+    }
+    eng = engines + i;
+    return 1;
+}
+
+
+/* Move on to the next engine that can run the board, since there isn't
+   enough memory for the one picked. The one the player asked for can be
+   anywhere in the list, so when it is the one that failed, the engines ahead
+   of it get their turn first. Returns 0 if there is none. */
+int next_engine( void )
+{
+    const struct engine *e;    /*< The next engine... */
+    const struct engine *w;    /*< ...and the one asked for. */
+    
+    w = ( wanted != NULL ) ? engine_named( wanted ) : NULL;
+    for ( e = ( eng == w ) ? engines : eng+1;
+          e->name != NULL && ( e == w || !engine_fits( e ) ); e++ ){};
+    if ( e->name == NULL )
+        return 0;
+    
+    sprintf( wbuffer, "There isn't enough memory for the %s engine, so the "
+                      "%s engine will run the board.", eng->name, e->name );
+    pmsg( wbuffer );
+    eng = e;
+    return 1;
+}
+
+
+/* Start working out the next generation in the background while the players
+   make up their minds, as if none of them will do anything. Only the engines
+   that read one grid and write the other can do this. The bit-packed ones
+   change the board in place, and are fast enough without. */
+void speculate( void )
+{
+    threads_finish();
+    spec = 0;
+    if ( stasis || eng->ahead == NULL )
+        return;
+    
+    /* Nobody is hatching until they say so. */
+    if ( rules_changed( 0 ) )
+        build_rules( 0 );
+    
+    memcpy( spec_scores, scores, sizeof(long)*10 );
+    spec_n = 0;
+    spec = 1;
+    threads_begin( eng->ahead, NULL );
+}
+
+
+/* The next state of the cell at x,y, worked out on its own. */
+static int next_cell( int x, int y )
+{
+    unsigned long n = 0;    /*< Colored neighbor counters. */
+    unsigned long r[4];     /*< Random numbers... */
+    unsigned long k = ~0UL; /*< ...and the block they belong to. */
+    int i, j, a, b;         /*< Iterators and neighbors. */
+    int c, t, v;            /*< Counters and the cell. */
+    
+    for ( i = -1; i <= 1; i++ )
+    {
+        for ( j = -1; j <= 1; j++ )
+        {
+            a = board_col( x+j );
+            b = board_row( y+i );
+            if ( ( i || j ) && a >= 0 && b >= 0 )
+                n += counter[ (int) lgrid[ at(a,b) ] ];
+        }
+    }
+    
+    v = lgrid[ at(x,y) ];
+    t = (int) ( ( n * 0x1111111UL ) >> 24 ) & 15;
+    c = chances[v][t];
+    c = ( c > 0 && c < 100 ) ? roll( x, y, gen_no, r, &k ) : 0;
+    return ( c < chances[v][t] ) ? passes[v][ majority( n ) ] : fails[v];
+}
+
+
+/* Finish the generation speculate() started. Cells the players changed since
+   only matter to themselves and their neighbors, so just those are worked
+   out again. Returns 0 if it's no good, because someone is hatching or too
+   much changed, in which case the generation has to be done from scratch. */
+static int end_speculation( void )
+{
+    int i, j, a, b, v;      /*< Iterators and cells. */
+    long d[10];             /*< The scores of the next generation. */
+    char *swap;             /*< Grid swapper. */
+    
+    threads_finish();
+    spec = 0;
+    
+    for ( i = 1; i < 10 && players[i][0] != P_HATCHING; i++ ){};
+    if ( i < 10 || spec_n > SPEC_N )
+        return 0;
+    
+    memcpy( d, spec_scores, sizeof(long)*10 );
+    for ( i = 0; i < threads_count(); i++ )
+    {
+        for ( j = 0; j < 10; j++ )
+            d[j] += deltas[i][j];
+    }
+    
+    for ( i = 0; i < spec_n*9; i++ )
+    {
+        a = board_col( spec_x[i/9] + i%3 - 1 );
+        b = board_row( spec_y[i/9] + i/3%3 - 1 );
+        if ( a < 0 || b < 0 )
+            continue;
+        
+        v = wgrid[ at(a,b) ];
+        if ( IS_ALIVE(v) ) d[ COLOR_OF(v) ] --;
+        v = next_cell( a, b );
+        if ( IS_ALIVE(v) ) d[ COLOR_OF(v) ] ++;
+        wgrid[ at(a,b) ] = v;
+    }
+    memcpy( scores, d, sizeof(long)*10 );
+    
+    last_engine = 0;
+    swap = lgrid;
+    lgrid = wgrid;
+    wgrid = swap;
+    
+    tiles_mark_all();
+    end_generation();
+    return 1;
+}
+
+
+/* Put the cell v at x,y in the grids, however they are kept. */
+static void dense_put( unsigned long x, unsigned long y, int v )
+{
+    dense_eng->set( (int) x, (int) y, v );
+}
+
+
+/* Move the board to the sparse engine when fewer cells than the player's
+   threshold are alive, in cells per ten thousand, and back to the grids when
+   more than the other threshold are. The gap between them keeps a board
+   that hovers around one from going back and forth. The cells and the dice
+   are the same either way, so nothing that draws, saves or sends the board
+   can tell. Cells can't be born with no neighbors on a sparse board, so
+   B(0) rules stay in the grids. */
+static void adapt_board( void )
+{
+    double pop = 0;         /*< Live cells, in ten thousandths... */
+    double cells;           /*< ...of the board. */
+    int x, y, v;            /*< Iterators and cells. */
+    
+    if ( dense_eng == NULL || loptions[OP_SPARSE_BELOW] == 0 )
+        return;
+    
+    for ( x = 0; x < 10; x++ )
+        pop += scores[x];
+    pop *= 10000;
+    cells = (double) gw * gh;
+    
+    if ( !sparse && pop < loptions[OP_SPARSE_BELOW] * cells &&
+         cells >= ADAPT_MIN && !loptions[OP_RULESTRING_B(0)] )
+    {
+        /* If it doesn't fit, it can stay where it is. */
+        if ( !sp_reset( gw, gh, loptions[OP_GRID_WRAP] ) )
+            return;
+        for ( y = 0; y < gh; y++ )
+        {
+            for ( x = 0; x < gw; x++ )
+            {
+                v = cell_at( x, y );
+                if ( v && !sp_set( x, y, v ) )
+                {
+                    sp_free();
+                    return;
+                }
+            }
+        }
+        
+        sparse = 1;
+        eng = engine_named( "sparse" );
+    }
+    else if ( sparse && pop > loptions[OP_DENSE_ABOVE] * cells )
+    {
+        sparse = 0;
+        eng = dense_eng;
+        last_engine = 0;
+        spread_grids( 1 );
+        sp_visit( dense_put );
+        sp_free();
+        tiles_mark_all();
+    }
+    else
+        return;
+    
+    /* The board hashes differently now. */
+    hist_n = 0;
+}
+
+
+/* Iterate the board over one generation of Life, handling colorization as
+   well. This is so horribly inefficient, but for a 7DRL, I'm not concerned
+   with efficiency. Which engine does it was picked with the board, and
+   changes as the board empties and fills. */
+void next_generation( void )
+{
+    if ( mapped )
+        checkpoint( gen_no, 0 );
+    
+    /* The generation may have been worked out while the players were busy. */
+    if ( !spec || !end_speculation() )
+        eng->step();
+    adapt_board();
+    if ( mapped )
+        spare_grid();
+}
+
+
+/* The next state of the middle cell of three rows of three, for HashLife.
+   The rules are deterministic, so there is no need to roll. */
+static int hl_rule( const char *cells )
+{
+    unsigned long n;        /*< Colored neighbor counters. */
+    int t, v;               /*< Number of neighbors and the cell. */
+    
+    n = counter[ (int) cells[0] ] + counter[ (int) cells[1] ] +
+        counter[ (int) cells[2] ] + counter[ (int) cells[3] ] +
+        counter[ (int) cells[5] ] + counter[ (int) cells[6] ] +
+        counter[ (int) cells[7] ] + counter[ (int) cells[8] ];
+    t = (int) ( ( n * 0x1111111UL ) >> 24 ) & 15;
+    v = cells[4];
+    
+    return ( chances[v][t] ) ? passes[v][ majority( n ) ] : fails[v];
+}
+
+
+/* Jump gens generations ahead. Deterministic rules on grids of rows go
+   through HashLife, which can skip thousands of generations at once.
+   Anything it can't do is done a few generations at a time. Generators are
+   only checked for enemy cells at the end of a jump, so when other cells
+   are deadly every generation is done the usual way, and a generator dies
+   at the generation it would have without the jump. Returns how many
+   generations HashLife jumped. */
+long fast_forward( long gens )
+{
+    long done = 0;          /*< Generations done so far... */
+    long jumped = 0;        /*< ...and how many HashLife did. */
+    int i, m, b;            /*< Iterator and rule masks. */
+    int jump = ( loptions[OP_OTHER_CELLS] != OPx_DEADLY );  /*< Can we skip
+                                        the checks between generations? */
+    
+    /* The boards on the way aren't seen, so they can't be part of a
+       cycle, and nothing worked out ahead of time is any good. */
+    hist_n = 0;
+    cycle = 0;
+    threads_finish();
+    spec = 0;
+    
+    /* Seeds hatch during a generation, so that one is done the usual way. */
+    for ( i = 1; i < 10 && gens > 0; i++ )
+    {
+        if ( players[i][0] == P_HATCHING )
+        {
+            next_generation();
+            gen_no++;
+            gens--;
+            break;
+        }
+    }
+    
+    if ( gens > 0 && jump && !sparse && !mapped && !packed && !tiled &&
+         deterministic_rules( &m, &b ) )
+    {
+        if ( rules_changed( 0 ) )
+            build_rules( 0 );
+        
+        done = hl_generations( lgrid + el(0,0), gw, gh, gw+2,
+                               loptions[OP_GRID_WRAP], gens, hl_rule );
+        jumped = done;
+        
+        /* Count the cells again, and have the other engines look at the
+           whole board. */
+        if ( done > 0 )
+        {
+            memset( scores, 0, sizeof(long)*10 );
+            for ( i = 0; i < gh; i++ )
             {
-                t += neighbors[c];
-                if ( neighbors[c] > m )
+                for ( m = 0; m < gw; m++ )
                 {
-                    m = neighbors[c];
-                    w = 0;
-                    b = c;
+                    b = lgrid[ el(m,i) ];
+                    if ( IS_ALIVE(b) )
+                        scores[ COLOR_OF(b) ] ++;
                 }
-                else if ( neighbors[c] == m )
-                    w = 1;
             }
             
-            /* Set the color. */
-            if ( w == 1 )
-                b = 0;
-            wgrid[ el(j,i) ] = b*10 + t;
+            tiles_mark_all();
+            gen_no += done;
+            end_generation();
+        }
+    }
+    
+    /* Fuzzy rules and boards kept in a file are worked on a block of
+       generations at a time. */
+    while ( done < gens )
+    {
+        i = (int) MIN( gens-done, BLOCK_K );
+        if ( i > 1 && jump && !sparse && !packed &&
+             ( mapped || !deterministic_rules( &m, &b ) ) )
+        {
+            if ( mapped )
+                checkpoint( gen_no, 0 );
+            block_generations( i );
+            if ( mapped )
+                spare_grid();
+            gen_no += i;
+            done += i;
+        }
+        else
+        {
+            next_generation();
+            gen_no++;
+            done++;
+        }
+    }
+    
+    return jumped;
+}
+
+
+/* Mix n bytes at p into the hash h. Every step can be undone, so two boards
+   that only differ in one word never hash the same. */
+static unsigned long hash_bytes( unsigned long h, const char *p, size_t n )
+{
+    unsigned long w;        /*< A word of cells. */
+    
+    for ( ; n > 0; n -= MIN( n, sizeof(w) ), p += sizeof(w) )
+    {
+        w = 0;
+        memcpy( &w, p, MIN( n, sizeof(w) ) );
+        h = ( h ^ w ) * 2654435761UL;
+        h ^= h >> 13;
+    }
+    
+    return h;
+}
+
+
+/* A hash of every cell and seed on the board. */
+static unsigned long board_hash( void )
+{
+    unsigned long h = 0;    /*< The hash. */
+    int i;                  /*< Iterator. */
+    
+    if ( sparse )
+        return sp_hash();
+    if ( packed || tiled )
+        return hash_bytes( h, lgrid, gbytes );
+    
+    /* The border is left out, since it isn't always up to date. */
+    for ( i = 0; i < gh; i++ )
+        h = hash_bytes( h, lgrid + el(0,i), gw );
+    
+    return h;
+}
+
+
+/* Add a cell of a sparse board to the copy kept of it. A copy that ran out
+   of room has more cells than there is room for. */
+static void keep_cell( unsigned long x, unsigned long y, int v )
+{
+    struct kept_cell *k;    /*< More room. */
+    
+    if ( kept_n > kept_room )
+        return;
+    if ( kept_n == kept_room )
+    {
+        k = realloc( kept_cells, sizeof(struct kept_cell) *
+                                 ( kept_room*2 + 64 ) );
+        if ( k == NULL )
+        {
+            kept_n++;
+            return;
+        }
+        kept_cells = k;
+        kept_room = kept_room*2 + 64;
+    }
+    
+    kept_cells[ kept_n ].x = x;
+    kept_cells[ kept_n ].y = y;
+    kept_cells[ kept_n ].v = v;
+    kept_n++;
+}
+
+
+/* Count a cell of a sparse board off against the copy kept of it. */
+static void count_cell( unsigned long x, unsigned long y, int v )
+{
+    (void) x;
+    (void) y;
+    (void) v;
+    kept_n--;
+}
+
+
+/* Keep a copy of the board, to see if it comes around again. Returns 0 if
+   there is no room for one. */
+static int keep_copy( void )
+{
+    int i;                  /*< Iterator. */
+    
+    kept_n = 0;
+    if ( sparse )
+    {
+        sp_visit( keep_cell );
+        return ( kept_n <= kept_room );
+    }
+    
+    if ( kept == NULL )
+        kept = grid_alloc( ( tiled ) ? psz : (size_t) gw*gh );
+    if ( kept == NULL )
+        return 0;
+    
+    if ( packed || tiled )
+        memcpy( kept, lgrid, gbytes );
+    for ( i = 0; i < gh && !packed && !tiled; i++ )
+        memcpy( kept + (size_t) i*gw, lgrid + el(0,i), gw );
+    return 1;
+}
+
+
+/* Is the board the same as the copy kept of it, cell for cell? */
+static int same_as_kept( void )
+{
+    unsigned long n = kept_n;   /*< The cells kept. */
+    unsigned long i;            /*< Iterator. */
+    
+    if ( sparse )
+    {
+        /* The same number of cells, all of them where they were. */
+        sp_visit( count_cell );
+        if ( kept_n != 0 )
+        {
+            kept_n = n;
+            return 0;
+        }
+        kept_n = n;
+        for ( i = 0; i < n; i++ )
+        {
+            if ( sp_get( kept_cells[i].x, kept_cells[i].y ) !=
+                 kept_cells[i].v )
+                return 0;
+        }
+        return 1;
+    }
+    
+    if ( packed || tiled )
+        return ( memcmp( kept, lgrid, gbytes ) == 0 );
+    for ( i = 0; i < (unsigned long) gh; i++ )
+    {
+        if ( memcmp( kept + (size_t) i*gw, lgrid + el(0,i), gw ) != 0 )
+            return 0;
+    }
+    return 1;
+}
+
+
+/* Look for the board repeating itself. The last CYCLE_N boards are hashed,
+   and once one comes around again with nobody having touched the board
+   since, every board from here to the generation limit is known. Boards can
+   hash the same without being the same, so a copy of the board is kept
+   then, and it is only taken for a cycle once the board comes around to
+   the copy again. Fuzzy
+   rules can't be counted on to repeat, and without a limit there is no end
+   to skip to, so neither are looked at. Neither are boards kept in a file,
+   which would all have to be read in again to hash them. */
+void find_cycle( void )
+{
+    unsigned long h;        /*< The hash of this board. */
+    int p, m, b;            /*< Period and rule masks. */
+    
+    if ( cycle || mapped || !loptions[OP_GENERATIONS] ||
+         gen_no >= loptions[OP_GENERATIONS] || !deterministic_rules( &m, &b ) )
+        return;
+    
+    /* A board touched since the copy was kept won't come around to it. */
+    if ( hist_n == 0 )
+        kept_p = 0;
+    if ( kept_p && gen_no == kept_gen + kept_p )
+    {
+        p = kept_p;
+        kept_p = 0;
+        if ( same_as_kept() )
+        {
+            cycle = p;
+            if ( p == 1 )
+                sprintf( wbuffer, "The board has stopped changing." );
+            else
+                sprintf( wbuffer, "The board repeats every %d generations.",
+                         p );
+            pmsg( wbuffer );
+            if ( game_mode == G_HOTSEAT || game_mode == G_NETPLAY )
+                pmsg( "If everyone presses 'f', the round skips to its end." );
+            else
+                pmsg( "Press 'f' to skip to the end of the round." );
+            return;
+        }
+    }
+    
+    h = board_hash();
+    for ( p = 1; p <= hist_n && !kept_p; p++ )
+    {
+        if ( history[ (gen_no-p) % CYCLE_N ] == h && keep_copy() )
+        {
+            kept_p = p;
+            kept_gen = gen_no;
         }
     }
     
-    /* Now go through the two arrays and set life/death based our neighbors
-       array. */
-    for ( i = 0; i < gw*gh; i++ )
+    history[ gen_no % CYCLE_N ] = h;
+    if ( hist_n < CYCLE_N )
+        hist_n++;
+}
+
+
+/* Skip to the generation limit of a board that repeats itself. Whole cycles
+   leave it as it was, so only the generations left over are worked out, and
+   the scores come along with them. */
+void skip_cycle( void )
+{
+    int left = loptions[OP_GENERATIONS] - gen_no;   /*< Generations to go. */
+    int p = cycle;          /*< The length of the cycle. */
+    
+    if ( left <= 0 )
+        return;
+    
+    fast_forward( left % p );
+    gen_no += left - left % p;
+    
+    sprintf( wbuffer, "Skipped ahead to generation %d.", gen_no );
+    pmsg( wbuffer );
+}
+
+
+/* The wall clock in seconds, for timing the engines. */
+static double bench_clock( void )
+{
+    #ifdef TIME_WITH_SYS_TIME
+        struct timeval tv;          /*< The time of day. */
+        
+        gettimeofday( &tv, NULL );
+        return tv.tv_sec + tv.tv_usec / 1000000.0;
+    #else
+        return (double) clock() / CLOCKS_PER_SEC;
+    #endif
+}
+
+
+/* Time gens generations of a Conquest board with six players on it using
+   every engine, and print the results. The board is the same every time, so
+   the numbers can be compared from run to run. Nothing is drawn. Sparse,
+   packed and tiled boards only have the one engine. */
+void bench_game( int gens )
+{
+    int i, j, k;            /*< Iterators. */
+    int kernel;             /*< The kernel the player picked. */
+    const struct engine *picked;    /*< The engine the game picked... */
+    const struct engine *adapt;     /*< ...and the one it comes back to. */
+    int grids;              /*< Is the board kept in grids of a byte a
+                                        cell? */
+    double t;               /*< Start time. */
+    char *stepped = NULL;   /*< The board after stepping through. */
+    static const char *names[] =
+        {"neighbors", "column sums", "automatic", "hashlife", "blocked"};
+    
+    gw = loptions[OP_GRID_WIDTH];
+    gh = loptions[OP_GRID_HEIGHT];
+    can_resume = 0;
+    if ( !alloc_board() )
+    {
+        printf( "No engine has room for a %dx%d board.\n", gw, gh );
+        return;
+    }
+    
+    start_workers();
+    printf( "%d generations of a %dx%d board with %d thread(s), picking the "
+            "%s engine:\n", gens, gw, gh, threads_count(), eng->name );
+    
+    kernel = loptions[OP_KERNEL];
+    picked = eng;
+    adapt = dense_eng;
+    grids = !sparse && !packed && !tiled;
+    game_mode = G_CONQUEST;
+    
+    /* A board kept in a file may not fit in memory, so it isn't copied to
+       check the engines against each other. */
+    if ( grids && !mapped )
+        stepped = malloc( sizeof(char)*gbytes );
+    for ( k = 0; k < 5; k++ )
     {
-        /* Get the random value from 0-99. Bias is negligible. */
-        c = rnd_31int() % 100;
+        /* Sparse, packed and tiled boards have the one engine. */
+        if ( !grids && k > 0 )
+            continue;
+        
+        init_genrand( 1 );
+        start_game( 5 );
+        eng = ( k < 2 && grids ) ? engine_named( "regular" ) : picked;
         
-        /* If the cell is alive, check the Survival rulestring. If not, check
-           the Birth rulestring. Update the score while we're at it. */
-        if ( lgrid[i] > 9 )
+        /* Only the automatic run goes sparse as the board empties. */
+        dense_eng = ( k == 2 ) ? adapt : NULL;
+        loptions[OP_KERNEL] = ( k == 0 ) ? OPx_NEIGHBORS : OPx_COLUMNS;
+        
+        t = bench_clock();
+        if ( k == 3 )
+            fast_forward( gens );
+        else if ( k == 4 )
         {
-            if ( c >= loptions[OP_RULESTRING_S( wgrid[i]%10 )] )
+            for ( i = 0; i < gens; i += BLOCK_K )
             {
-                scores[ lgrid[i]%10 ] --;
-                lgrid[i] = 0;
+                block_generations( MIN( gens-i, BLOCK_K ) );
+                gen_no += MIN( gens-i, BLOCK_K );
             }
-            else if ( wgrid[i]/10 )
+        }
+        else
+        {
+            for ( i = 0; i < gens; i++ )
             {
-                scores[ lgrid[i]%10 ] --;
-                lgrid[i] = 10 + wgrid[i]/10;
-                scores[ lgrid[i]%10 ] ++;
+                next_generation();
+                gen_no++;
             }
         }
-        else
+        t = bench_clock() - t;
+        
+        printf( "  %-12s %10.3f ms/generation",
+                ( !grids ) ? picked->name : names[k], t * 1000.0 / gens );
+        
+        /* Every engine has to end up with the same board. */
+        if ( stepped != NULL && k == 0 )
+            memcpy( stepped, lgrid, sizeof(char)*gbytes );
+        else if ( stepped != NULL )
         {
-            /* If the cell is dead OR if it has a seed, the rules of birth
-               take precedence over seed hatching. */
-            if ( c < loptions[OP_RULESTRING_B( wgrid[i]%10 )] )
+            for ( i = 0; i < gh; i++ )
             {
-                lgrid[i] = 10 + wgrid[i]/10;
-                scores[ lgrid[i]%10 ] ++;
+                for ( j = 0; j < gw && stepped[ el(j,i) ] == cell_at( j, i );
+                      j++ ){};
+                if ( j < gw )
+                    break;
             }
-            
-            /* Spawn seeds if the player has designated hatching. */
-            if ( lgrid[i] > 0 && players[ (int) lgrid[i] ][0] == P_HATCHING )
+            if ( i < gh )
+                printf( "  (different board!)" );
+        }
+        printf( "\n" );
+    }
+    
+    if ( stepped != NULL ) free( stepped );
+    loptions[OP_KERNEL] = kernel;
+    eng = picked;
+    game_mode = 0;
+    free_board();
+}
+
+
+/* Set the -check board up for the engine called name, or for the one the
+   game picks if name is NULL. Returns 0 if no engine has room for it. */
+static int check_engine( const char *name, int threads )
+{
+    free_board();
+    wanted = name;
+    loptions[OP_THREADS] = threads;
+    if ( !alloc_board() )
+    {
+        printf( "  No engine has room for the board.\n" );
+        return 0;
+    }
+    
+    start_workers();
+    return 1;
+}
+
+
+/* Change a few cells of the -check board the way players would, some
+   generations more than a generation worked out ahead can fix up. Live
+   cells are harvested and empty ones get a live cell of the first player.
+   The cells are picked by r, so every run changes the same ones. */
+static void check_edit( unsigned long *r )
+{
+    int i, n;               /*< Iterator and how many to change. */
+    int x, y, v;            /*< The cell. */
+    
+    n = ( gen_no % 100 == 50 ) ? SPEC_N+1 : 3;
+    for ( i = 0; i < n; i++ )
+    {
+        *r = ( *r * 1103515245UL + 12345UL ) & 0xffffffffUL;
+        x = (int) ( ( *r >> 8 ) % gw );
+        *r = ( *r * 1103515245UL + 12345UL ) & 0xffffffffUL;
+        y = (int) ( ( *r >> 8 ) % gh );
+        
+        /* A board of noise stays colorless. */
+        v = cell_at( x, y );
+        if ( IS_ALIVE( v ) && set_cell( x, y, 0 ) )
+            scores[ COLOR_OF( v ) ] --;
+        else if ( v == 0 && loptions[OP_NOISE] &&
+                  set_cell( x, y, CELL_LIVE ) )
+            scores[0] ++;
+        else if ( v == 0 && set_cell( x, y, CELL_LIVE|2 ) )
+            scores[2] ++;
+    }
+}
+
+
+/* Play the -check board from the start to generation gens, and leave its
+   cells in board and its scores in score. How it gets there is up to how:
+   0 works out every generation, 1 skips to the end as soon as the board
+   repeats itself, as if 'f' was pressed as soon as it could be, and 2
+   fast-forwards all the way. 3 changes cells every generation, and 4 does
+   the same while the generation is worked out ahead, like a game does.
+   Returns the generation a cycle was found at, or 0 if none was, and when
+   fast-forwarding, how many generations HashLife jumped. */
+static int check_run( int gens, int how, char *board, long *score )
+{
+    int x, y;               /*< Iterators. */
+    int found = 0;          /*< Where the cycle was found. */
+    unsigned long r = 1;    /*< Picks the cells to change. */
+    
+    /* A sparse board is only filled in one corner, so it is filled all the
+       way here to start out the same as the others. A board of noise has
+       no players' cells on it, so the bit-packed engine runs it without
+       colors. */
+    sw = gw;
+    sh = gh;
+    init_genrand( 1 );
+    start_game( ( loptions[OP_NOISE] ) ? 0 : 5 );
+    if ( how == 2 )
+        found = (int) fast_forward( gens );
+    while ( gen_no < gens )
+    {
+        if ( how == 4 )
+            speculate();
+        if ( how >= 3 )
+            check_edit( &r );
+        next_generation();
+        gen_no++;
+        if ( how == 1 )
+            find_cycle();
+        if ( cycle )
+        {
+            found = gen_no;
+            skip_cycle();
+        }
+    }
+    
+    for ( y = 0; y < gh; y++ )
+    {
+        for ( x = 0; x < gw; x++ )
+            board[ (size_t) y*gw + x ] = (char) cell_at( x, y );
+    }
+    memcpy( score, scores, sizeof(long)*10 );
+    return found;
+}
+
+
+/* Print whether the board what left matches the first one, for -check, and
+   where it was found to repeat itself, if it was. Returns 0 if it doesn't
+   match. */
+static int check_same( const char *what, int found, const char *want,
+                       const char *got, const long *want_score,
+                       const long *got_score )
+{
+    if ( memcmp( want, got, sizeof(char)*gw*gh ) != 0 ||
+         memcmp( want_score, got_score, sizeof(long)*10 ) != 0 )
+    {
+        printf( "  %-22s FAILED, the board isn't the same\n", what );
+        return 0;
+    }
+    
+    if ( found )
+        printf( "  %-22s ok, repeats itself from generation %d\n", what,
+                found );
+    else
+        printf( "  %-22s ok\n", what );
+    return 1;
+}
+
+
+/* Check that the board a game is left with doesn't depend on how it got
+   there, for -check. The board is played to a limit of gens generations
+   by every engine that can run it, on one thread and on as many as the
+   player asked for, fast-forwarded, and skipped to the end of its cycle if
+   it has one, and every one of them has to end up with the same cells and
+   scores as the first. Then cells are changed as it plays, and the engines
+   that work out generations ahead have to end up the same as when they
+   don't. Returns 0 if anything doesn't match. */
+int check_game( int gens )
+{
+    const struct engine *e; /*< The engine being checked. */
+    const char *asked = wanted; /*< The engine the player asked for. */
+    char *want, *got;       /*< The boards at the end... */
+    long want_score[10];    /*< ...and their scores. */
+    long got_score[10];
+    int limit;              /*< The generation limit the player picked. */
+    int threads;            /*< The threads the player asked for. */
+    char what[32];          /*< What is being checked. */
+    int t;
+    int found;              /*< Where the cycle was found. */
+    int first = 1;          /*< Is this the first board? */
+    int ok = 1;             /*< Has everything matched? */
+    int m, b;               /*< Rule masks. */
+    
+    gw = loptions[OP_GRID_WIDTH];
+    gh = loptions[OP_GRID_HEIGHT];
+    can_resume = 0;
+    if ( !deterministic_rules( &m, &b ) )
+    {
+        printf( "Only boards with no chances in their rulestrings can be "
+                "checked.\n" );
+        return 0;
+    }
+    
+    want = malloc( sizeof(char)*gw*gh );
+    got = malloc( sizeof(char)*gw*gh );
+    if ( want == NULL || got == NULL )
+    {
+        printf( "Not enough memory to check a %dx%d board.\n", gw, gh );
+        if ( want != NULL ) free( want );
+        if ( got != NULL ) free( got );
+        return 0;
+    }
+    
+    printf( "%d generations of a %dx%d board:\n", gens, gw, gh );
+    limit = loptions[OP_GENERATIONS];
+    threads = loptions[OP_THREADS];
+    loptions[OP_GENERATIONS] = gens;
+    game_mode = G_CONQUEST;
+    
+    /* Every engine that can run the board, on one thread and then on
+       the rest, unless that's only one too. */
+    for ( e = engines; e->name != NULL && ok; e++ )
+    {
+        if ( !engine_fits( e ) )
+            continue;
+        for ( t = 0; t < 2 && ok; t++ )
+        {
+            if ( !check_engine( e->name, t ? threads : 1 ) )
+                ok = 0;
+            else if ( t && threads_count() == 1 )
+                break;
+            else
             {
-                lgrid[i] += 10;
-                scores[ lgrid[i]%10 ] ++;
+                sprintf( what, "%s, %d thread%s", eng->name,
+                         threads_count(), threads_count() > 1 ? "s" : "" );
+                check_run( gens, 0, first ? want : got,
+                           first ? want_score : got_score );
+                if ( first )
+                    printf( "  %-22s ok\n", what );
+                else
+                    ok = check_same( what, 0, want, got, want_score,
+                                     got_score );
+                first = 0;
             }
         }
     }
     
-    /* Turn off all players set to hatching. Also, if a player is standing on
-       an opposing color's cell while DEADLY is running, set him to dead. */
-    for ( i = 0; i < 10; i++ )
+    /* The engine the game picks, fast-forwarding... */
+    if ( ok )
+        ok = check_engine( asked, threads );
+    if ( ok )
     {
-        if ( players[i][0] == P_HATCHING )
-            players[i][0] = P_PLAYING;
-            
-        if ( loptions[OP_OTHER_CELLS] == OPx_DEADLY &&
-             players[i][0] == P_PLAYING &&
-             lgrid[ el( players[i][1], players[i][2] ) ] > 10 &&
-             lgrid[ el( players[i][1], players[i][2] ) ] - 10 != i )
-            players[i][0] = P_DEAD;
+        found = check_run( gens, 2, got, got_score );
+        ok = check_same( found ? "fast-forward, hashlife" : "fast-forward",
+                         0, want, got, want_score, got_score );
+    }
+    
+    /* ...and skipping to the end of the cycle, if the board has one. */
+    if ( ok )
+        ok = check_engine( asked, threads );
+    if ( ok )
+    {
+        found = check_run( gens, 1, got, got_score );
+        if ( found )
+            ok = check_same( "cycle", found, want, got, want_score,
+                             got_score );
+        else
+            printf( "  %-22s didn't repeat itself\n", "cycle" );
+    }
+    
+    /* Cells changed while the next generation is worked out ahead have to
+       come out the same as when it's worked out after. */
+    for ( e = engines; e->name != NULL && ok; e++ )
+    {
+        if ( !engine_fits( e ) || e->ahead == NULL )
+            continue;
+        ok = check_engine( e->name, threads );
+        if ( ok )
+        {
+            check_run( gens, 3, want, want_score );
+            ok = check_engine( e->name, threads );
+        }
+        if ( ok )
+        {
+            sprintf( what, "%s, ahead", e->name );
+            check_run( gens, 4, got, got_score );
+            ok = check_same( what, 0, want, got, want_score, got_score );
+        }
+    }
+    
+    free( want );
+    free( got );
+    wanted = asked;
+    loptions[OP_GENERATIONS] = limit;
+    loptions[OP_THREADS] = threads;
+    game_mode = 0;
+    free_board();
+    return ok;
+}
+
+
+/* Count up n rolls by value, where what is how they were rolled: 0 for the
+   dice of the cells, 1 for the Mersenne Twister, and 2 for the dice of the
+   cells with a bound of 3*2^30. That throws out a quarter of the numbers,
+   and without throwing them out, half of the rolls would leave nothing over
+   after dividing by 3, so they are counted by what they leave over. Prints
+   how even they are, and returns 0 if they are too lopsided to be chance,
+   or out of range. */
+static int dice_even( long n, int what )
+{
+    static const char *names[] =
+        {"cell dice", "twister dice", "cell dice, 3*2^30"};
+    static const double limits[] = { 160.2, 160.2, 18.4 };  /*< What chi
+                                        squared gets over one time in ten
+                                        thousand. */
+    unsigned long bound = ( what == 2 ) ? 3UL << 30 : 100;
+    int k = ( what == 2 ) ? 3 : 100;    /*< The values counted. */
+    long count[100];        /*< How many of each came up. */
+    unsigned long r[FILL_N];    /*< The rolls. */
+    long i;                 /*< Iterator. */
+    int j, m;               /*< Iterators. */
+    double x = 0, e;        /*< Chi squared, and the count expected. */
+    
+    memset( count, 0, sizeof(count) );
+    init_genrand( 1 );
+    for ( i = 0; i < n; i += m )
+    {
+        m = (int) MIN( n-i, FILL_N );
+        if ( what == 1 )
+            rnd_below( r, m, bound );
+        for ( j = 0; j < m && what != 1; j += 4 )
+            rnd_cells_below( 1, 0, (unsigned long) i+j, bound, r+j );
+        for ( j = 0; j < m; j++ )
+        {
+            if ( r[j] >= bound )
+            {
+                printf( "  %-22s FAILED, %lu is out of range\n", names[what],
+                        r[j] );
+                return 0;
+            }
+            count[ r[j] % k ] ++;
+        }
     }
+    
+    e = (double) n / k;
+    for ( j = 0; j < k; j++ )
+        x += ( count[j] - e ) * ( count[j] - e ) / e;
+    printf( "  %-22s %s, chi squared %.1f for %d values\n", names[what],
+            ( x < limits[what] ) ? "ok" : "FAILED", x, k );
+    return ( x < limits[what] );
+}
+
+
+/* Check that the dice come out even, for -dice, rolling each of them n
+   times. Returns 0 if any of them don't. */
+int check_dice( long n )
+{
+    int ok = 1;             /*< Has everything come out even? */
+    int i;                  /*< Iterator. */
+    
+    printf( "%ld rolls of the dice:\n", n );
+    for ( i = 0; i < 3; i++ )
+        ok = dice_even( n, i ) && ok;
+    return ok;
 }
 
 
@@ -1376,6 +3876,14 @@ void save_bitmap( int challenge )
     { {0,0,0}, {0,0,255}, {0,255,255}, {0,255,0}, {255,255,0}, {255,0,0},
       {255,0,255}, {255,255,255} };
     
+    /* Every cell takes up 48 bytes, and the whole file has to fit in four
+       gigabytes. */
+    if ( (double) gw*gh*48 + 54 > 4294967295.0 )
+    {
+        pmsg( "The board is too big to save as a bitmap." );
+        return;
+    }
+    
     /* Get the file open. */
     memset( fname, 0, sizeof(char)*50 );
     sprintf( fname, "life%d.bmp", (int) time(NULL) );
@@ -1391,7 +3899,7 @@ void save_bitmap( int challenge )
     /* Write the bitmap header data. */
     cval = 'B';                        fwrite( &cval, sizeof(char), 1, ofile );
     cval = 'M';                        fwrite( &cval, sizeof(char), 1, ofile );
-    ival = 54+(gw*gh*3*4);             writeint( ival, ofile );
+    ival = 54+(unsigned int) gw*gh*12; writeint( ival, ofile );
     ival = 0;                          writeint( ival, ofile );
     ival = 54;                         writeint( ival, ofile );
     ival = 40;                         writeint( ival, ofile );
@@ -1402,7 +3910,7 @@ void save_bitmap( int challenge )
     cval = 24;                         fwrite( &cval, sizeof(char), 1, ofile );
     cval = 0;                          fwrite( &cval, sizeof(char), 1, ofile );
     ival = 0;                          writeint( ival, ofile );
-    ival = gw*gh*3*4;                  writeint( ival, ofile );
+    ival = (unsigned int) gw*gh*12;    writeint( ival, ofile );
     ival = 2835;                       writeint( ival, ofile );
                                        writeint( ival, ofile );
     ival = 0;                          writeint( ival, ofile );
@@ -1429,14 +3937,14 @@ void save_bitmap( int challenge )
             else
             {
                 ival = 0;
-                cval = lgrid[ el( j/4, i/4 ) ];
+                cval = cell_at( j/4, i/4 );
                 
                 /* Get the right color. */
-                if ( cval == 10 ) ival = 7;
-                else              ival = cval%10;
+                if ( cval == CELL_LIVE ) ival = 7;
+                else                     ival = COLOR_OF(cval);
                 
                 /* If it's not alive, only draw two pixels. */
-                if ( cval < 9 && j%2 == i%2 )
+                if ( !IS_ALIVE(cval) && j%2 == i%2 )
                     ival = 0;
                 
                 /* Challenge mode uses id colors. */
@@ -1464,9 +3972,8 @@ int load_challenge( char *fname )
     unsigned char pixels[12];   /*< Pixel input. */
     char c;                     /*< Output val. */
     
-    /* Free the pointers, as we need to resize the grid. */
-    free( wgrid );
-    free( lgrid );
+    /* Free the board, as we need to resize the grid. */
+    free_board();
     
     /* No file? Fail! */
     ifile = fopen( fname, "rb" );
@@ -1486,18 +3993,17 @@ int load_challenge( char *fname )
     gw /= 4;
     gh /= 4;
     
-    lgrid = calloc( sizeof(char), gw*gh );
-    wgrid = calloc( sizeof(char), gw*gh );
-    if ( lgrid == NULL || wgrid == NULL )
+    if ( !alloc_board() )
     {
-        /* Redundant error checking is redundant. */
-        if ( lgrid != NULL ) free( lgrid );
-        if ( wgrid != NULL ) free( wgrid );
         fclose( ifile );
-        
         return 0;
     }
     
+    /* The board is a new size, so the workers start over, and take their
+       parts of it before it is filled. */
+    start_workers();
+    spread_grids( 0 );
+    
     players[1][1] = 0;
     players[1][2] = 0;
     
@@ -1505,14 +4011,13 @@ int load_challenge( char *fname )
     fseek( ifile, offs, SEEK_SET );
     for ( i = gh-1; i >= 0; i-- )
     {
-        fseek( ifile, gw*4*3, SEEK_CUR );
+        fseek( ifile, (long) gw*4*3, SEEK_CUR );
         for ( j = 0; j < gw; j++ )
         {
             if ( fread( pixels, sizeof(unsigned char), 12, ifile ) != 12 )
             {
                 /* If we come up short, just shut down. */
-                free( lgrid );
-                free( wgrid );
+                free_board();
                 fclose( ifile );
                 
                 return 0;
@@ -1537,13 +4042,14 @@ int load_challenge( char *fname )
                  (pixels[6] || pixels[7] || pixels[8]) )
             {
                 scores[(int) c] += 1;
-                c += 10;
+                c |= CELL_LIVE;
             }
-            lgrid[ el(j,i) ] = c;
+            set_cell( j, i, c );
         }
-        fseek( ifile, gw*4*3*2, SEEK_CUR );
+        fseek( ifile, (long) gw*4*3*2, SEEK_CUR );
     }
     
+    tiles_mark_all();
     fclose( ifile );
     return 1;
 }
@@ -41,6 +41,10 @@ void play_game( int game_mode, int num_players );
 void start_game( int num_players );
 int *life_opts( void );
 void pmsg( char *s );
+int force_engine( const char *name );
+void keep_board( const char *name );
+int pick_engine( void );
+int next_engine( void );
 
 /* Game board handlers. */
 void handle_input( void );
@@ -48,7 +52,14 @@ void draw_all( int curplayer );
 void draw_grid(int x1, int y1, int x2, int y2, int lx, int ly, int curplayer);
 void draw_status( int x1, int y1, int x2, int y2, int curplayer );
 void draw_messages( int x1, int y1, int x2, int y2 );
+void speculate( void );
 void next_generation( void );
+long fast_forward( long gens );
+void find_cycle( void );
+void skip_cycle( void );
+void bench_game( int gens );
+int check_game( int gens );
+int check_dice( long n );
 
 /* Bitmap saving and loading. */
 void save_bitmap( int challenge );